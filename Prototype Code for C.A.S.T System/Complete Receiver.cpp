@@ -7,10 +7,27 @@
 #include <cstdlib>
 #include <algorithm>
 #include <filesystem>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+#include <deque>
+#include <array>
+#include <complex>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include <wiringPi.h>
 #include <RF24/RF24.h>
 #include <sndfile.h>
+#include <alsa/asoundlib.h>
 #include "codec2.h"
+#include "Message Log Store.h"
+#include "Relay Tree.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -22,9 +39,63 @@ namespace fs = std::filesystem;
 #define PIN_CE 17
 #define PIN_CSN 0
 #define GPIO_LED 22
+#define MESSAGE_SEPARATOR '\x1e'  // between messages the transmitters coalesce into one transfer
+#define STS_HEADER 4            // STS packet: length (0xFF = EOF), origin, uint16 sequence, then whole Codec2 frames
+
+// Relay configuration (tree addressing and duplicate filtering are in Relay Tree.h)
+#define RELAY_STATS_INTERVAL 100
+
+// A transfer silent for longer than this was abandoned by the transmitter (text chunks
+// arrive every 500 ms); whatever arrives next starts a new transfer
+#define RX_TRANSFER_TIMEOUT_MS 1000
+
+// Speech cache configuration
+#define TTS_VOICE "en"
+#define TTS_CACHE_DIR "logs/tts_cache"
+#define TTS_CACHE_SIZE 32       // recent messages kept in memory besides the fixed phrases
+
+// Keyword spotting configuration (STS audio)
+#define KWS_DIR "keywords"      // enrolled keyword recordings, 8 kHz mono .wav
+#define KWS_FRAME 200           // 25 ms analysis frame
+#define KWS_HOP 80              // 10 ms hop
+#define KWS_FFT 256
+#define KWS_MELS 20
+#define KWS_CEPS 12            // c1-c12; c0 is dropped so input level does not matter
+#define KWS_THRESHOLD 20.0f     // max average frame distance for a match
 
 RF24 radio(PIN_CE, PIN_CSN);
 
+// Packet capture / replay state (see receivePacket)
+struct PacketCapture {
+    ofstream out;                                   // --capture target, if open
+    ifstream in;                                    // --replay source, if open
+    double speed = 1.0;                             // replay speed multiplier, 0 = as fast as possible
+    bool finished = false;                          // replay source exhausted
+    chrono::steady_clock::time_point start;         // capture start / replay start
+    uint64_t firstTimestampNs = 0;                  // timestamp of first replayed record
+    bool haveFirst = false;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t duplicates = 0;
+};
+PacketCapture capture;
+
+DedupHistory recentPackets;     // drops copies heard both directly and via a relay
+uint8_t lastPipe = 1;   // pipe the latest payload arrived on, recorded as the message sender
+uint64_t lastPacketNs = 0;
+
+// First packet of a new transfer that cut into an abandoned one; receivePacket hands it out again
+struct HeldPacket {
+    uint8_t data[PACKET_SIZE];
+    uint8_t len = 0;
+    uint8_t pipe = 1;
+    uint64_t timestampNs = 0;
+    bool valid = false;
+};
+HeldPacket heldPacket;
+
+bool replaying() { return capture.in.is_open(); }
+
 //---- Utility Functions -----------------------------------------------------
 
 // Generate current timestamp string for filenames
@@ -36,21 +107,317 @@ string getTimestamp() {
     return ss.str();
 }
 
+// Indexed store of every received message (query with Message Log Query Tool)
+MessageLogStore& messageStore() {
+    static MessageLogStore store;
+    return store;
+}
+
+// Record a message from the sender on the latest pipe. Replayed captures are not live
+// traffic and would be stamped with today's time, so they stay out of the store.
+void storeReceivedMessage(const string& mode, const string& text) {
+    if (replaying()) return;
+    messageStore().append(MESSAGE_DIRECTION_RECEIVED, mode, "pipe" + to_string(lastPipe), text);
+}
+
+// Quote a CSV field if it contains a separator, quote or line break
+string csvField(const string& field) {
+    if (field.find_first_of(",\"\r\n") == string::npos) return field;
+    string quoted = "\"";
+    for (char c : field) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
 // Add event info to central log CSV
 void logToCSV(const string& type, const string& filename, const string& message = "") {
+    static mutex csvMutex; // shared with the keyword spotter thread
+    lock_guard<mutex> lock(csvMutex);
     fs::create_directories("logs");
     ofstream csv("logs/log_summary.csv", ios::app);
-    csv << getTimestamp() << "," << type << "," << filename << "," << message << endl;
+    csv << getTimestamp() << "," << type << "," << csvField(filename) << "," << csvField(message) << endl;
+}
+
+// ---- Speech Cache -------------------------------------------------------
+//
+// Phrases are synthesised once with espeak into PCM, kept in memory and played
+// straight to ALSA. Fixed announcements and the transmitters' emergency presets
+// are pinned and saved under TTS_CACHE_DIR (keyed by voice + text) so later runs
+// skip synthesis; other messages go through a small LRU. On a miss, espeak's
+// output is played as it arrives, so long messages do not wait for synthesis.
+
+struct SpeechClip {
+    unsigned int rate = 0;
+    vector<short> samples;
+};
+
+const vector<string> fixedPhrases = {
+    "Incoming Emergency",
+    "Emergency message received!",
+    "Emergency! I need help immediately.",
+    "There's a fire!",
+    "I'm in danger, call emergency services.",
+    "Medical emergency, please respond!",
+    "Intruder alert!"
+};
+
+unordered_map<string, SpeechClip> pinnedClips;
+list<pair<string, SpeechClip>> recentClips;                                   // most recent first
+unordered_map<string, list<pair<string, SpeechClip>>::iterator> recentIndexByText;
+
+// Quote text for the shell
+string shellQuote(const string& text) {
+    string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+}
+
+// Disk cache file for a phrase
+string speechCachePath(const string& text) {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    for (char c : string(TTS_VOICE) + "\n" + text) hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.wav", static_cast<unsigned long long>(hash));
+    return string(TTS_CACHE_DIR) + "/" + name;
+}
+
+// Run espeak and parse the WAV it writes to stdout. Samples are handed to onAudio
+// (if given) as they arrive; it returns false to stop listening.
+bool synthesiseSpeech(const string& text, SpeechClip& clip,
+                      const function<bool(const short*, size_t)>& onAudio = nullptr) {
+    string cmd = "espeak --stdout -v " TTS_VOICE " " + shellQuote(text);
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) return false;
+    string wav;
+    char chunk[4096];
+    size_t n;
+    size_t pos = 12, dataStart = 0, dataBytes = 0;
+    bool listening = static_cast<bool>(onAudio);
+    while ((n = fread(chunk, 1, sizeof(chunk), pipe)) > 0) {
+        wav.append(chunk, n);
+        if (wav.size() >= 12 && wav.compare(0, 4, "RIFF") != 0) break;
+
+        // Walk the RIFF chunks; espeak streams with placeholder sizes, so data runs to the end
+        while (!dataStart && pos + 8 <= wav.size()) {
+            uint32_t size;
+            memcpy(&size, &wav[pos + 4], 4);
+            if (wav.compare(pos, 4, "fmt ") == 0) {
+                if (pos + 16 > wav.size()) break;
+                memcpy(&clip.rate, &wav[pos + 12], 4);
+            } else if (wav.compare(pos, 4, "data") == 0) {
+                dataStart = pos + 8;
+                dataBytes = size;
+                break;
+            }
+            pos += 8 + size;
+        }
+
+        // Copy out every whole sample received so far
+        if (dataStart && clip.rate > 0) {
+            size_t available = min<size_t>(dataBytes, wav.size() - dataStart) / sizeof(short);
+            size_t from = clip.samples.size();
+            clip.samples.resize(available);
+            memcpy(clip.samples.data() + from, &wav[dataStart + from * sizeof(short)], (available - from) * sizeof(short));
+            if (listening && available > from) listening = onAudio(clip.samples.data() + from, available - from);
+        }
+    }
+    return pclose(pipe) == 0 && dataStart && clip.rate > 0;
+}
+
+// Load / store a clip in the disk cache
+bool loadSpeechClip(const string& path, SpeechClip& clip) {
+    SF_INFO sfinfo = {};
+    SNDFILE* file = sf_open(path.c_str(), SFM_READ, &sfinfo);
+    if (!file) return false;
+    clip.rate = sfinfo.samplerate;
+    clip.samples.resize(sfinfo.frames * sfinfo.channels);
+    sf_read_short(file, clip.samples.data(), clip.samples.size());
+    sf_close(file);
+    return sfinfo.channels == 1;
+}
+
+void saveSpeechClip(const string& path, const SpeechClip& clip) {
+    fs::create_directories(TTS_CACHE_DIR);
+    SF_INFO sfinfo = {};
+    sfinfo.channels = 1;
+    sfinfo.samplerate = clip.rate;
+    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    SNDFILE* file = sf_open(path.c_str(), SFM_WRITE, &sfinfo);
+    if (!file) return;
+    sf_write_short(file, clip.samples.data(), clip.samples.size());
+    sf_close(file);
+}
+
+// Synthesise fixed phrases (or load them from disk) so alerts play without waiting on espeak
+void preloadSpeechCache() {
+    auto start = chrono::steady_clock::now();
+    for (const string& phrase : fixedPhrases) {
+        SpeechClip clip;
+        string path = speechCachePath(phrase);
+        if (!loadSpeechClip(path, clip)) {
+            if (!synthesiseSpeech(phrase, clip)) continue;
+            saveSpeechClip(path, clip);
+        }
+        pinnedClips[phrase] = move(clip);
+    }
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    cout << "[TTS] " << pinnedClips.size() << " phrases cached in " << elapsed.count() << " ms\n";
+}
+
+// Find a clip in memory
+const SpeechClip* cachedSpeech(const string& text) {
+    auto pinned = pinnedClips.find(text);
+    if (pinned != pinnedClips.end()) return &pinned->second;
+
+    auto recent = recentIndexByText.find(text);
+    if (recent != recentIndexByText.end()) {
+        recentClips.splice(recentClips.begin(), recentClips, recent->second);
+        return &recent->second->second;
+    }
+    return nullptr;
+}
+
+// Remember a freshly synthesised clip, evicting the least recently spoken one
+void rememberSpeech(const string& text, SpeechClip&& clip) {
+    recentClips.emplace_front(text, move(clip));
+    recentIndexByText[text] = recentClips.begin();
+    if (recentClips.size() > TTS_CACHE_SIZE) {
+        recentIndexByText.erase(recentClips.back().first);
+        recentClips.pop_back();
+    }
+}
+
+// ALSA playback of 16 bit mono PCM, opened on the first samples and drained when done
+class SpeechPlayer {
+public:
+    SpeechPlayer(chrono::steady_clock::time_point requested, const string& source)
+        : requested(requested), source(source) {}
+
+    ~SpeechPlayer() {
+        if (pcm) {
+            snd_pcm_drain(pcm);
+            snd_pcm_close(pcm);
+        }
+    }
+
+    // Queue samples for playback; false once the device has failed
+    bool play(unsigned int rate, const short* samples, size_t count) {
+        if (failed) return false;
+        if (!pcm) {
+            if (snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+                pcm = nullptr;
+                failed = true;
+                return false;
+            }
+            if (snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                                   1, rate, 1, 100000) < 0) {
+                failed = true;
+                return false;
+            }
+        }
+
+        size_t offset = 0;
+        while (offset < count) {
+            snd_pcm_sframes_t written = snd_pcm_writei(pcm, samples + offset, count - offset);
+            if (written < 0) written = snd_pcm_recover(pcm, written, 0);
+            if (written < 0) {
+                failed = true;
+                return false;
+            }
+            if (written > 0 && !started) {
+                chrono::duration<double, milli> latency = chrono::steady_clock::now() - requested;
+                cout << "[TTS] " << source << ", first audio after " << latency.count() << " ms\n";
+                started = true;
+            }
+            offset += written;
+            played += written;
+        }
+        return true;
+    }
+
+    // Everything handed to play() was written
+    bool complete() const { return pcm && !failed; }
+
+    // Samples written to the device so far
+    size_t samplesPlayed() const { return played; }
+
+private:
+    snd_pcm_t* pcm = nullptr;
+    chrono::steady_clock::time_point requested;
+    string source;
+    size_t played = 0;
+    bool started = false;
+    bool failed = false;
+};
+
+// Play a clip from memory starting at sample <from>; false unless every sample was written.
+// <played> is left at the end of what reached the device.
+bool playSpeech(const SpeechClip& clip, size_t from, chrono::steady_clock::time_point requested,
+                const string& source, size_t& played) {
+    SpeechPlayer player(requested, source);
+    bool ok = true;
+    for (size_t offset = from; ok && offset < clip.samples.size(); offset += clip.rate / 10) {
+        size_t frames = min<size_t>(clip.samples.size() - offset, clip.rate / 10);
+        ok = player.play(clip.rate, clip.samples.data() + offset, frames);
+    }
+    played = from + player.samplesPlayed();
+    return ok && player.complete();
+}
+
+// Synthesise and play at the same time, caching the clip; false unless all of it played
+bool streamSpeech(const string& text, chrono::steady_clock::time_point requested, size_t& played) {
+    SpeechClip clip;
+    bool complete;
+    {
+        SpeechPlayer player(requested, "synthesised");
+        bool synthesised = synthesiseSpeech(text, clip, [&](const short* samples, size_t count) {
+            return player.play(clip.rate, samples, count);
+        });
+        complete = synthesised && player.complete();
+        played = player.samplesPlayed();
+        if (synthesised) rememberSpeech(text, move(clip));
+    }
+    return complete;
 }
 
 // Speak text out loud
 void speakText(const string& text) {
-    string cmd = "espeak \"" + text + "\"";
-    system(cmd.c_str());
+    if (replaying()) {
+        cout << "[REPLAY] Speech suppressed: " << text << endl;
+        return;
+    }
+    static mutex speechMutex; // the keyword spotter's alert can speak from another thread
+    lock_guard<mutex> lock(speechMutex);
+    auto requested = chrono::steady_clock::now();
+    size_t played = 0;
+    const SpeechClip* clip = cachedSpeech(text);
+    if (clip ? playSpeech(*clip, 0, requested, "cached", played) : streamSpeech(text, requested, played)) return;
+
+    if (played == 0) {
+        // Nothing was heard, so let espeak play it directly
+        string cmd = "espeak " + shellQuote(text);
+        system(cmd.c_str());
+        return;
+    }
+
+    // Part of the message was heard: carry on from where the device stopped rather than
+    // repeating it (the clip is cached whenever synthesis finished)
+    clip = cachedSpeech(text);
+    if (clip && (played >= clip->samples.size() || playSpeech(*clip, played, requested, "resumed", played))) return;
+    cerr << "[TTS] Playback failed part way through, rest of message not spoken: " << text << endl;
 }
 
 // Blink LED and announce emergency
 void blinkLED(int durationMs, int rateMs) {
+    if (replaying()) {
+        cout << "[REPLAY] Emergency alert suppressed.\n";
+        return;
+    }
     int elapsed = 0;
     while (elapsed < durationMs) {
         speakText("Incoming Emergency");
@@ -62,6 +429,15 @@ void blinkLED(int durationMs, int rateMs) {
     }
 }
 
+// LED and spoken announcement for an emergency; serialised so alerts from the
+// receive loop and the keyword spotter never overlap
+void raiseEmergencyAlert() {
+    static mutex alertMutex;
+    lock_guard<mutex> lock(alertMutex);
+    blinkLED(10000, 50);
+    speakText("Emergency message received!");
+}
+
 // Detect emergency keywords in .txt file
 bool detectEmergencyKeywords(const string& message) {
     const vector<string> keywords = {"emergency", "help", "urgent", "danger", "alarm"};
@@ -76,6 +452,184 @@ bool detectEmergencyKeywords(const string& message) {
     return false;
 }
 
+// ---- Packet Capture & Replay -------------------------------------------
+//
+// Capture file layout (little-endian, as written on the Pi):
+//   header : char magic[8] = "CASTCAP1", uint32 version, uint32 snaplen, uint64 start (unix epoch ns)
+//   record : uint64 timestamp (ns since start), uint8 pipe, uint8 length, uint8 payload[length]
+
+#define CAPTURE_MAGIC "CASTCAP1"
+#define CAPTURE_VERSION 1
+
+// Open capture file and write its header
+bool openCapture(const string& filename) {
+    if (fs::path(filename).has_parent_path()) fs::create_directories(fs::path(filename).parent_path());
+    capture.out.open(filename, ios::binary | ios::trunc);
+    if (!capture.out) return false;
+
+    uint32_t version = CAPTURE_VERSION;
+    uint32_t snaplen = PACKET_SIZE;
+    uint64_t startEpochNs = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    capture.out.write(CAPTURE_MAGIC, 8);
+    capture.out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    capture.out.write(reinterpret_cast<const char*>(&snaplen), sizeof(snaplen));
+    capture.out.write(reinterpret_cast<const char*>(&startEpochNs), sizeof(startEpochNs));
+    capture.out.flush();
+    capture.start = chrono::steady_clock::now();
+    return true;
+}
+
+// Nanoseconds since capture / replay start
+uint64_t elapsedNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - capture.start).count();
+}
+
+// Append one raw payload to the capture file
+void capturePacket(uint64_t timestampNs, uint8_t pipe, const uint8_t* payload, uint8_t len) {
+    capture.out.write(reinterpret_cast<const char*>(&timestampNs), sizeof(timestampNs));
+    capture.out.put(static_cast<char>(pipe));
+    capture.out.put(static_cast<char>(len));
+    capture.out.write(reinterpret_cast<const char*>(payload), len);
+    capture.out.flush(); // keep the file usable if the receiver dies mid-session
+}
+
+// Open capture file for replay and validate its header
+bool openReplay(const string& filename) {
+    capture.in.open(filename, ios::binary);
+    if (!capture.in) return false;
+
+    char magic[8];
+    uint32_t version = 0, snaplen = 0;
+    uint64_t startEpochNs = 0;
+    capture.in.read(magic, 8);
+    capture.in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    capture.in.read(reinterpret_cast<char*>(&snaplen), sizeof(snaplen));
+    capture.in.read(reinterpret_cast<char*>(&startEpochNs), sizeof(startEpochNs));
+    if (!capture.in || memcmp(magic, CAPTURE_MAGIC, 8) != 0 || version != CAPTURE_VERSION) {
+        capture.in.close();
+        return false;
+    }
+    capture.start = chrono::steady_clock::now();
+    return true;
+}
+
+// Read next record from the replay file, pacing it to its original timing / speed
+bool replayPacket(uint8_t* buffer, uint8_t& len, uint8_t& pipe, uint64_t& timestampNs) {
+    char recordPipe, length;
+    if (!capture.in.read(reinterpret_cast<char*>(&timestampNs), sizeof(timestampNs)) ||
+        !capture.in.get(recordPipe) || !capture.in.get(length)) {
+        capture.finished = true;
+        return false;
+    }
+    pipe = static_cast<uint8_t>(recordPipe);
+    len = static_cast<uint8_t>(length);
+    if (len > PACKET_SIZE || !capture.in.read(reinterpret_cast<char*>(buffer), len)) {
+        cerr << "[REPLAY] Truncated or corrupt record, stopping.\n";
+        capture.finished = true;
+        return false;
+    }
+
+    if (!capture.haveFirst) {
+        capture.firstTimestampNs = timestampNs;
+        capture.haveFirst = true;
+    }
+    if (capture.speed > 0) {
+        auto due = capture.start + chrono::nanoseconds(
+            static_cast<uint64_t>((timestampNs - capture.firstTimestampNs) / capture.speed));
+        this_thread::sleep_until(due);
+    }
+    return true;
+}
+
+// Fetch next payload from the radio (recording it if capturing) or from the replay file,
+// dropping relay duplicates. Returns false once the replay file is exhausted.
+bool receivePacket(RF24& radio, uint8_t* buffer, uint8_t& len) {
+    if (heldPacket.valid) {
+        memcpy(buffer, heldPacket.data, heldPacket.len);
+        len = heldPacket.len;
+        lastPipe = heldPacket.pipe;
+        lastPacketNs = heldPacket.timestampNs;
+        heldPacket.valid = false;
+        return true;
+    }
+
+    while (true) {
+        uint8_t pipe;
+        uint64_t timestampNs;
+        if (replaying()) {
+            if (!replayPacket(buffer, len, pipe, timestampNs)) return false;
+        } else {
+            while (!radio.available(&pipe)) delayMicroseconds(200);
+            timestampNs = elapsedNs();
+            len = radio.getDynamicPayloadSize();
+            if (len > PACKET_SIZE) len = PACKET_SIZE;
+            radio.read(buffer, len);
+            if (capture.out.is_open()) capturePacket(timestampNs, pipe, buffer, len);
+        }
+        capture.packets++;
+        capture.bytes += len;
+
+        if (!isDuplicate(recentPackets, pipe, timestampNs, buffer, len)) {
+            lastPipe = pipe;
+            lastPacketNs = timestampNs;
+            return true;
+        }
+        capture.duplicates++;
+    }
+}
+
+// Check the packet just received against the previous one of the same transfer. After a
+// long silence the transmitter has given up and is resending from the start, so the packet
+// is held for the next receive and the caller discards its partial transfer.
+bool transferAbandoned(uint64_t previousNs, const uint8_t* buffer, uint8_t len) {
+    if (lastPacketNs - previousNs <= RX_TRANSFER_TIMEOUT_MS * 1000000ULL) return false;
+    memcpy(heldPacket.data, buffer, len);
+    heldPacket.len = len;
+    heldPacket.pipe = lastPipe;
+    heldPacket.timestampNs = lastPacketNs;
+    heldPacket.valid = true;
+    cout << "[RX] Transfer abandoned by transmitter, discarding partial data.\n";
+    return true;
+}
+
+// ---- Relay Mode ---------------------------------------------------------
+//
+// Each node forwards to its parent in the octal relay tree (see Relay Tree.h).
+// The hop latency printed here is the measured figure to give the Relay Tree Simulator.
+
+// Forward every payload toward the parent as soon as it arrives (cut-through,
+// so Codec2 frames are not held back until the end of a message)
+void runRelay(uint16_t node) {
+    radio.startListening();
+    cout << "[RELAY] Node 0" << oct << node << " forwarding to node 0" << parentNode(node) << dec << endl;
+
+    uint8_t buffer[PACKET_SIZE];
+    uint8_t len;
+    uint64_t forwarded = 0, failed = 0;
+    double totalLatencyUs = 0, maxLatencyUs = 0;
+
+    while (receivePacket(radio, buffer, len)) {
+        auto received = chrono::steady_clock::now();
+        radio.stopListening();
+        bool ok = radio.write(buffer, len);
+        radio.startListening();
+
+        double latencyUs = chrono::duration<double, micro>(chrono::steady_clock::now() - received).count();
+        totalLatencyUs += latencyUs;
+        maxLatencyUs = max(maxLatencyUs, latencyUs);
+        if (ok) forwarded++;
+        else failed++;
+
+        if ((forwarded + failed) % RELAY_STATS_INTERVAL == 0) {
+            cout << "[RELAY] forwarded " << forwarded << ", failed " << failed
+                 << ", duplicates dropped " << capture.duplicates
+                 << ", hop latency avg " << totalLatencyUs / (forwarded + failed)
+                 << " us, max " << maxLatencyUs << " us\n";
+        }
+    }
+}
+
 // ---- Text Mode Handling -----------------------------------------------
 
 // Save received message and log it
@@ -83,6 +637,10 @@ string saveMessageToLogFile(const string& message, const string& mode) {
     fs::create_directories("logs");
     string timestamp = getTimestamp();
     string filename = "logs/" + mode + "_" + timestamp + ".txt";
+    for (int n = 2; fs::exists(filename); ++n) {
+        // Several messages from one coalesced transfer land within the same second
+        filename = "logs/" + mode + "_" + timestamp + "_" + to_string(n) + ".txt";
+    }
     ofstream out(filename);
     out << message;
     out.close();
@@ -90,23 +648,38 @@ string saveMessageToLogFile(const string& message, const string& mode) {
     return filename;
 }
 
-// Receive text file over RF24
-string receiveFile(RF24& radio) {
-    radio.startListening();
+// Split a transfer back into the messages a transmitter coalesced into it
+vector<string> splitMessages(const string& transfer) {
+    vector<string> messages;
+    size_t start = 0, end;
+    while ((end = transfer.find(MESSAGE_SEPARATOR, start)) != string::npos) {
+        messages.push_back(transfer.substr(start, end - start));
+        start = end + 1;
+    }
+    messages.push_back(transfer.substr(start));
+    return messages;
+}
+
+// Receive text file over RF24. startsTransfer is set for the mode identifier; the message
+// that follows must keep up with it. Returns false if the transmitter abandoned it part way.
+bool receiveFile(RF24& radio, string& text, bool startsTransfer = false) {
+    if (!replaying()) radio.startListening();
     stringstream messageStream;
-    char buffer[32];
+    uint8_t buffer[PACKET_SIZE];
+    uint8_t len;
+    bool checkGap = !startsTransfer;
+    uint64_t previousNs = lastPacketNs;
 
-    while (true) {
-        if (radio.available()) {
-            int len = radio.getDynamicPayloadSize();
-            radio.read(buffer, len);
-            if (len >= 3 && strncmp(buffer, "EOF", 3) == 0) break;
-            messageStream.write(buffer, len);
-        }
-        delay(100);
+    while (receivePacket(radio, buffer, len)) {
+        if (checkGap && transferAbandoned(previousNs, buffer, len)) return false;
+        checkGap = true;
+        previousNs = lastPacketNs;
+        if (len >= 3 && strncmp(reinterpret_cast<char*>(buffer), "EOF", 3) == 0) break;
+        messageStream.write(reinterpret_cast<char*>(buffer), len);
     }
 
-    return messageStream.str();
+    text = messageStream.str();
+    return true;
 }
 
 // Save .wav file function
@@ -124,6 +697,309 @@ bool saveWavFile(const string& filename, const vector<short>& samples) {
     return true;
 }
 
+// ---- Keyword Spotting ---------------------------------------------------
+//
+// Decoded STS audio is streamed to a spotter thread so a spoken keyword raises the
+// emergency alert while the message is still arriving. Keywords are enrolled as
+// short 8 kHz mono recordings in KWS_DIR (e.g. keywords/help.wav); each incoming
+// 10 ms MFCC frame advances a subsequence DTW against every template, so detection
+// lags the end of the word by one frame plus queueing, not by the whole message.
+
+typedef array<float, KWS_CEPS> FeatureFrame;
+
+// Streaming MFCC front end: 25 ms Hamming frames every 10 ms, 20 mel bands, cepstra c1-c12
+class MfccExtractor {
+public:
+    MfccExtractor() {
+        for (int i = 0; i < KWS_FRAME; ++i) window[i] = 0.54f - 0.46f * cos(2 * M_PI * i / (KWS_FRAME - 1));
+
+        auto toMel = [](float hz) { return 2595.0f * log10(1.0f + hz / 700.0f); };
+        auto toHz = [](float mel) { return 700.0f * (pow(10.0f, mel / 2595.0f) - 1.0f); };
+        float lowMel = toMel(100.0f), highMel = toMel(3800.0f);
+        int bins[KWS_MELS + 2];
+        for (int m = 0; m < KWS_MELS + 2; ++m) {
+            float hz = toHz(lowMel + (highMel - lowMel) * m / (KWS_MELS + 1));
+            bins[m] = static_cast<int>((KWS_FFT + 1) * hz / SAMPLE_RATE);
+        }
+        for (int m = 0; m < KWS_MELS; ++m) {
+            melFilters[m].assign(KWS_FFT / 2 + 1, 0.0f);
+            for (int k = bins[m]; k < bins[m + 1]; ++k)
+                melFilters[m][k] = float(k - bins[m]) / max(1, bins[m + 1] - bins[m]);
+            for (int k = bins[m + 1]; k < bins[m + 2]; ++k)
+                melFilters[m][k] = float(bins[m + 2] - k) / max(1, bins[m + 2] - bins[m + 1]);
+        }
+    }
+
+    // Feed samples; completed feature frames are appended to out
+    void process(const short* samples, size_t count, vector<FeatureFrame>& out) {
+        pending.insert(pending.end(), samples, samples + count);
+        size_t pos = 0;
+        while (pending.size() - pos >= KWS_FRAME) {
+            out.push_back(compute(pending.data() + pos));
+            pos += KWS_HOP;
+        }
+        pending.erase(pending.begin(), pending.begin() + pos);
+    }
+
+private:
+    float window[KWS_FRAME];
+    vector<float> melFilters[KWS_MELS];
+    vector<short> pending;
+
+    // In-place radix-2 FFT
+    static void fft(vector<complex<float>>& x) {
+        size_t n = x.size();
+        for (size_t i = 1, j = 0; i < n; ++i) {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) swap(x[i], x[j]);
+        }
+        for (size_t len = 2; len <= n; len <<= 1) {
+            complex<float> step = polar(1.0f, float(-2 * M_PI / len));
+            for (size_t i = 0; i < n; i += len) {
+                complex<float> w = 1;
+                for (size_t k = 0; k < len / 2; ++k, w *= step) {
+                    complex<float> u = x[i + k], v = x[i + k + len / 2] * w;
+                    x[i + k] = u + v;
+                    x[i + k + len / 2] = u - v;
+                }
+            }
+        }
+    }
+
+    FeatureFrame compute(const short* frame) {
+        vector<complex<float>> spectrum(KWS_FFT, 0.0f);
+        for (int i = 0; i < KWS_FRAME; ++i) spectrum[i] = window[i] * frame[i] / 32768.0f;
+        fft(spectrum);
+
+        float logMel[KWS_MELS];
+        for (int m = 0; m < KWS_MELS; ++m) {
+            float energy = 0;
+            for (int k = 0; k <= KWS_FFT / 2; ++k) energy += melFilters[m][k] * norm(spectrum[k]);
+            logMel[m] = log(energy + 1e-10f);
+        }
+
+        FeatureFrame cepstra;
+        for (int i = 0; i < KWS_CEPS; ++i) {
+            cepstra[i] = 0;
+            for (int m = 0; m < KWS_MELS; ++m) cepstra[i] += logMel[m] * cos(M_PI * (i + 1) * (m + 0.5f) / KWS_MELS);
+        }
+        return cepstra;
+    }
+};
+
+float frameDistance(const FeatureFrame& a, const FeatureFrame& b) {
+    float sum = 0;
+    for (int i = 0; i < KWS_CEPS; ++i) sum += (a[i] - b[i]) * (a[i] - b[i]);
+    return sqrt(sum);
+}
+
+struct KeywordTemplate {
+    string name;
+    vector<FeatureFrame> frames;
+};
+vector<KeywordTemplate> keywordTemplates;
+
+// Load enrolled keyword recordings, trimming leading / trailing silence
+void loadKeywordTemplates() {
+    if (!fs::is_directory(KWS_DIR)) return;
+    for (const auto& entry : fs::directory_iterator(KWS_DIR)) {
+        if (entry.path().extension() != ".wav") continue;
+        SF_INFO sfinfo = {};
+        SNDFILE* file = sf_open(entry.path().c_str(), SFM_READ, &sfinfo);
+        if (!file) continue;
+        vector<short> samples(sfinfo.frames * sfinfo.channels);
+        sf_read_short(file, samples.data(), samples.size());
+        sf_close(file);
+        if (sfinfo.samplerate != SAMPLE_RATE || sfinfo.channels != CHANNELS) {
+            cerr << "[KWS] Skipping " << entry.path() << ": must be " << SAMPLE_RATE << " Hz mono\n";
+            continue;
+        }
+
+        // Keep the span between the first and last 10 ms block above 10% of peak RMS
+        vector<double> rms;
+        for (size_t i = 0; i + KWS_HOP <= samples.size(); i += KWS_HOP) {
+            double sum = 0;
+            for (size_t j = i; j < i + KWS_HOP; ++j) sum += double(samples[j]) * samples[j];
+            rms.push_back(sqrt(sum / KWS_HOP));
+        }
+        if (rms.empty()) continue;
+        double peak = *max_element(rms.begin(), rms.end());
+        size_t first = 0, last = rms.size() - 1;
+        while (first < last && rms[first] < 0.1 * peak) first++;
+        while (last > first && rms[last] < 0.1 * peak) last--;
+
+        KeywordTemplate keyword;
+        keyword.name = entry.path().stem().string();
+        MfccExtractor mfcc;
+        mfcc.process(samples.data() + first * KWS_HOP, (last - first + 1) * KWS_HOP, keyword.frames);
+        if (keyword.frames.size() < 5) continue;
+        keywordTemplates.push_back(keyword);
+    }
+    cout << "[KWS] " << keywordTemplates.size() << " keyword template(s) loaded from " << KWS_DIR << endl;
+}
+
+// Runs alerts for spoken keywords so neither the spotter nor the receive loop waits on
+// them. One worker thread; an alert raised while another is pending is merged into it.
+class AlertWorker {
+public:
+    ~AlertWorker() { stop(); }
+
+    void raise() {
+        lock_guard<mutex> lock(alertQueueMutex);
+        if (!worker.joinable()) worker = thread(&AlertWorker::run, this);
+        pending = true;
+        alertReady.notify_one();
+    }
+
+    // Finish a pending alert, then stop (before main returns, e.g. at the end of a replay)
+    void stop() {
+        {
+            lock_guard<mutex> lock(alertQueueMutex);
+            stopping = true;
+        }
+        alertReady.notify_one();
+        if (worker.joinable()) worker.join();
+    }
+
+private:
+    mutex alertQueueMutex;
+    condition_variable alertReady;
+    thread worker;
+    bool pending = false;
+    bool stopping = false;
+
+    void run() {
+        unique_lock<mutex> lock(alertQueueMutex);
+        while (true) {
+            alertReady.wait(lock, [this] { return pending || stopping; });
+            if (!pending) return;
+            pending = false;
+            lock.unlock();
+            raiseEmergencyAlert();
+            lock.lock();
+        }
+    }
+};
+AlertWorker alertWorker;
+
+// Spotter thread for one STS session
+class KeywordSpotter {
+public:
+    void start() {
+        if (keywordTemplates.empty()) return;
+        for (const KeywordTemplate& keyword : keywordTemplates) {
+            cost.emplace_back(keyword.frames.size(), INFINITY);
+            length.emplace_back(keyword.frames.size(), 0);
+        }
+        worker = thread(&KeywordSpotter::run, this);
+    }
+
+    // Hand decoded samples to the spotter (called from the receive loop, never blocks on DSP)
+    void push(const vector<short>& samples) {
+        if (!worker.joinable()) return;
+        lock_guard<mutex> lock(queueMutex);
+        chunks.push_back({samples, chrono::steady_clock::now()});
+        queueReady.notify_one();
+    }
+
+    // Process what is left, stop the thread and report real-time factor / latency
+    void finish() {
+        if (!worker.joinable()) return;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            done = true;
+        }
+        queueReady.notify_one();
+        worker.join();
+
+        double audioSeconds = double(frameCount) * KWS_HOP / SAMPLE_RATE;
+        if (audioSeconds > 0) {
+            cout << "[KWS] " << audioSeconds << " s of audio, real-time factor " << processingSeconds / audioSeconds;
+            if (detected) cout << ", detection latency " << detectionLatencyMs << " ms";
+            cout << endl;
+        }
+    }
+
+private:
+    struct Chunk {
+        vector<short> samples;
+        chrono::steady_clock::time_point arrived;
+    };
+
+    thread worker;
+    mutex queueMutex;
+    condition_variable queueReady;
+    deque<Chunk> chunks;
+    bool done = false;
+
+    MfccExtractor mfcc;
+    vector<vector<float>> cost;      // per template: accumulated DTW cost ending at each template frame
+    vector<vector<int>> length;      // per template: stream frames on that path
+    size_t frameCount = 0;
+    double processingSeconds = 0;
+    bool detected = false;
+    double detectionLatencyMs = 0;
+
+    void run() {
+        vector<FeatureFrame> frames;
+        while (true) {
+            Chunk chunk;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return !chunks.empty() || done; });
+                if (chunks.empty()) return;
+                chunk = move(chunks.front());
+                chunks.pop_front();
+            }
+
+            auto start = chrono::steady_clock::now();
+            frames.clear();
+            mfcc.process(chunk.samples.data(), chunk.samples.size(), frames);
+            for (const FeatureFrame& frame : frames) {
+                frameCount++;
+                if (!detected) match(frame, chunk.arrived);
+            }
+            processingSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    // Advance every template's DTW by one stream frame. A match may start at any frame;
+    // each step consumes one stream frame and advances the template by 0, 1 or 2 frames.
+    void match(const FeatureFrame& frame, chrono::steady_clock::time_point arrived) {
+        for (size_t t = 0; t < keywordTemplates.size(); ++t) {
+            const vector<FeatureFrame>& ref = keywordTemplates[t].frames;
+            vector<float> prevCost = cost[t];
+            vector<int> prevLength = length[t];
+
+            for (size_t j = 0; j < ref.size(); ++j) {
+                float best = 0;
+                int bestLength = 0;
+                if (j > 0) {
+                    best = prevCost[j];
+                    bestLength = prevLength[j];
+                    if (prevCost[j - 1] < best) best = prevCost[j - 1], bestLength = prevLength[j - 1];
+                    if (j > 1 && prevCost[j - 2] < best) best = prevCost[j - 2], bestLength = prevLength[j - 2];
+                }
+                cost[t][j] = best + frameDistance(frame, ref[j]);
+                length[t][j] = bestLength + 1;
+            }
+
+            size_t end = ref.size() - 1;
+            if (length[t][end] * 2 >= int(ref.size()) && cost[t][end] / length[t][end] < KWS_THRESHOLD) {
+                detected = true;
+                detectionLatencyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - arrived).count();
+                cout << "[KWS] Keyword \"" << keywordTemplates[t].name << "\" spotted (score "
+                     << cost[t][end] / length[t][end] << ", " << detectionLatencyMs << " ms after arrival)\n";
+                logToCSV("STS-KEYWORD", keywordTemplates[t].name);
+                alertWorker.raise();
+                return;
+            }
+        }
+    }
+};
+
 // ---- Speech Mode Handling -----------------------------------------------
 
 // STS Receiver - Audio Receiver, Decoder and Save
@@ -132,8 +1008,7 @@ void receiveSTS() {
     size_t nsam = codec2_samples_per_frame(codec2);
     size_t nbytes = codec2_bytes_per_frame(codec2);
 
-    radio.startListening();
-    vector<unsigned char> buffer;
+    if (!replaying()) radio.startListening();
     vector<short> allSamples;
 
     cout << "[STS] Listening for audio packets...\n";
@@ -144,86 +1019,220 @@ void receiveSTS() {
     fs::create_directories("logs/STT");
     ofstream rawOut(rawFile, ios::binary);
 
-    while (true) {
-        if (radio.available()) {
-            vector<unsigned char> packet(PACKET_SIZE);
-            radio.read(packet.data(), PACKET_SIZE);
+    KeywordSpotter spotter;
+    spotter.start();
 
-            unsigned char length = packet[0];
-            if (length == 0xFF) {
-                cout << "[STS] EOF received.\n";
-                break;
-            }
+    vector<unsigned char> packet(PACKET_SIZE);
+    uint8_t len;
+    uint64_t previousNs = lastPacketNs;
+    bool abandoned = false;
+    bool haveSequence = false;
+    uint8_t origin = 0;
+    uint16_t expected = 0;
+    uint64_t lost = 0;
+    while (receivePacket(radio, packet.data(), len)) {
+        if (transferAbandoned(previousNs, packet.data(), len)) {
+            abandoned = true;
+            break;
+        }
+        previousNs = lastPacketNs;
+        fill(packet.begin() + len, packet.end(), 0);
 
-            if (length == 0 || length > PACKET_SIZE - 1) continue;
+        // Sequence numbers run on across the transfer, EOF included, so a gap is lost packets.
+        // A relayed packet can land after a later one heard directly; it is then no longer lost.
+        uint16_t sequence = packet[2] | (packet[3] << 8);
+        uint16_t gap = sequence - expected;
+        if (!haveSequence || packet[1] != origin || gap < 0x8000) {
+            if (haveSequence && packet[1] == origin) lost += gap;
+            haveSequence = true;
+            origin = packet[1];
+            expected = sequence + 1;
+        } else if (lost > 0) {
+            lost--;
+        }
 
-            buffer.insert(buffer.end(), packet.begin() + 1, packet.begin() + 1 + length);
+        unsigned char length = packet[0];
+        if (length == 0xFF) {
+            cout << "[STS] EOF received.\n";
+            break;
+        }
 
-            while (buffer.size() >= nbytes) {
-                vector<short> samples(nsam);
-                codec2_decode(codec2, samples.data(), buffer.data());
+        if (length == 0 || length > PACKET_SIZE - STS_HEADER) continue;
 
-                allSamples.insert(allSamples.end(), samples.begin(), samples.end());
-                rawOut.write(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(short));
+        // Each packet holds whole frames, so a lost packet cannot shift later frame boundaries
+        for (size_t offset = 0; offset + nbytes <= length; offset += nbytes) {
+            vector<short> samples(nsam);
+            codec2_decode(codec2, samples.data(), packet.data() + STS_HEADER + offset);
 
-                buffer.erase(buffer.begin(), buffer.begin() + nbytes);
-            }
+            allSamples.insert(allSamples.end(), samples.begin(), samples.end());
+            rawOut.write(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(short));
+            spotter.push(samples);
         }
     }
+    if (lost) cout << "[STS] " << lost << " audio packet(s) lost in transit.\n";
 
     rawOut.close();
     codec2_destroy(codec2);
+    spotter.finish();
+
+    if (abandoned) {
+        // The transmitter resends the whole recording
+        fs::remove(rawFile);
+        return;
+    }
 
     // Save WAV and log
     if (saveWavFile(wavFile, allSamples)) {
         cout << "[STS] Audio saved as WAV: " << wavFile << endl;
         logToCSV("STS", wavFile, "Audio saved as WAV");
+        storeReceivedMessage("STS", wavFile);
     } else {
         cerr << "[STS] Failed to save WAV.\n";
     }
 }
 
+// Print usage for command line options
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--relay <node> [--access]] [--capture <file>] | [--replay <file> [--speed <x>|max]]\n"
+         << "  --relay <node>    forward all traffic toward the base; node is an octal tree id (e.g. 01, 021)\n"
+         << "  --access          with --relay, also accept transmitters using the base address\n"
+         << "  --capture <file>  record every raw RF24 payload to a capture file\n"
+         << "  --replay <file>   feed a capture file through the receiver instead of the radio\n"
+         << "  --speed <x>|max   replay speed multiplier (default 1 = real time)\n";
+}
+
+// Print replay throughput summary
+void printReplayStats() {
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - capture.start;
+    cout << "[REPLAY] " << capture.packets << " packets, " << capture.bytes << " bytes in "
+         << elapsed.count() << " s (" << capture.packets / elapsed.count() << " packets/s, "
+         << capture.bytes / elapsed.count() << " bytes/s, " << capture.duplicates << " duplicates dropped)\n";
+}
+
 // Main Communication Loop
-int main() {
-    wiringPiSetupGpio();
-    pinMode(GPIO_LED, OUTPUT);
+int main(int argc, char* argv[]) {
+    string captureFile, replayFile;
+    bool relay = false, access = false;
+    uint16_t node = 0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--relay" && i + 1 < argc) {
+            relay = true;
+            if (!parseNode(argv[++i], node)) {
+                cerr << "Invalid relay node: " << argv[i] << " (octal digits 1-" << MAX_CHILDREN
+                     << ", at most " << MAX_HOPS << " levels)\n";
+                return 1;
+            }
+        } else if (arg == "--access") {
+            access = true;
+        } else if (arg == "--capture" && i + 1 < argc) {
+            captureFile = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayFile = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            string speed = argv[++i];
+            capture.speed = (speed == "max") ? 0.0 : atof(speed.c_str());
+            if (speed != "max" && capture.speed <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((!captureFile.empty() && !replayFile.empty()) || (relay && !replayFile.empty()) || (access && !relay)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Replay mode - no radio or GPIO needed
+    if (!replayFile.empty()) {
+        if (!openReplay(replayFile)) {
+            cerr << "[REPLAY] Cannot open capture file: " << replayFile << endl;
+            return 1;
+        }
+        cout << "[REPLAY] Replaying " << replayFile << endl;
+    }
+
+    if (!replaying()) {
+        wiringPiSetupGpio();
+        pinMode(GPIO_LED, OUTPUT);
+        capture.start = chrono::steady_clock::now();
+    }
+
+    if (!captureFile.empty()) {
+        if (!openCapture(captureFile)) {
+            cerr << "[CAPTURE] Cannot open capture file: " << captureFile << endl;
+            return 1;
+        }
+        cout << "[CAPTURE] Recording packets to " << captureFile << endl;
+    }
 
     // RF24 setup
-    radio.begin();
-    radio.setChannel(121);
-    radio.setPALevel(RF24_PA_HIGH);
-    radio.setDataRate(RF24_2MBPS);
-    radio.setAutoAck(true);
-    radio.enableDynamicPayloads();
-    radio.setRetries(15, 15);
-    radio.openWritingPipe(0x7878787878LL);
-    radio.openReadingPipe(1, 0x7878787878LL);
+    if (!replaying()) {
+        radio.begin();
+        radio.setChannel(121);
+        radio.setPALevel(RF24_PA_HIGH);
+        radio.setDataRate(RF24_2MBPS);
+        radio.setAutoAck(true);
+        radio.enableDynamicPayloads();
+        radio.setRetries(15, 15);
+
+        // Pipe 1 is this node's own address, pipes 2-5 its child relays
+        for (uint8_t pipe = 1; pipe <= 1 + MAX_CHILDREN; ++pipe) {
+            radio.openReadingPipe(pipe, nodePipeAddress(node, pipe));
+        }
+        if (relay) {
+            if (access) radio.openReadingPipe(0, nodePipeAddress(0, 1));
+            radio.openWritingPipe(uplinkAddress(node));
+        } else {
+            radio.openWritingPipe(0x7878787878LL);
+        }
+    }
+
+    if (relay) {
+        runRelay(node);
+        return 0;
+    }
+
+    if (!replaying()) preloadSpeechCache();
+    loadKeywordTemplates();
 
     // Main dispatch loop
-    while (true) {
+    while (!capture.finished) {
         cout << "\n[WAITING] Awaiting mode...\n";
-        string mode = receiveFile(radio);
+        string mode;
+        bool complete = receiveFile(radio, mode, true);
+        if (capture.finished) break;
+        if (!complete) continue;
         cout << "[MODE] Received: " << mode << endl;
 
         if (mode == "STS") {
             receiveSTS();
         } else if (mode == "STT" || mode == "TTS" || mode == "TTT") {
             cout << "[TEXT] Awaiting message...\n";
-            string message = receiveFile(radio);
-            cout << "[TEXT] Message: " << message << endl;
+            string transfer;
+            complete = receiveFile(radio, transfer);
+            if (capture.finished) break;
+            if (!complete) continue;
 
-            string file = saveMessageToLogFile(message, mode);
+            for (const string& message : splitMessages(transfer)) {
+                cout << "[TEXT] Message: " << message << endl;
 
-            if (detectEmergencyKeywords(message)) {
-                blinkLED(10000, 50);
-                speakText("Emergency message received!");
-            }
+                string file = saveMessageToLogFile(message, mode);
+                storeReceivedMessage(mode, message);
+
+                if (detectEmergencyKeywords(message)) raiseEmergencyAlert();
 
-            speakText(message);
+                speakText(message);
+            }
         } else {
             cout << "[UNKNOWN] Mode: " << mode << endl;
         }
     }
 
+    alertWorker.stop();
+    if (replaying()) printReplayStats();
     return 0;
 }
@@ -0,0 +1,444 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "Message Log Store.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+#define SEGMENT_MAGIC "CASTSEG1"
+#define DEFAULT_LIMIT 50
+#define BENCH_QUERY_RUNS 20
+#define BENCH_MARKER ".bench_store"    // marks a scratch store the benchmark may wipe
+
+// Read-only memory mapping of a whole file
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool open(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        size = lseek(fd, 0, SEEK_END);
+        if (size > 0) {
+            void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            data = (map == MAP_FAILED) ? nullptr : static_cast<const uint8_t*>(map);
+        }
+        ::close(fd);
+        return size == 0 || data != nullptr;
+    }
+
+    ~MappedFile() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+    }
+};
+
+struct MessageView {
+    uint64_t timestampMs;
+    char direction;
+    string mode, sender, text;
+};
+
+// Query side of the store: everything is read through mmap, nothing is loaded up front
+class MessageLogReader {
+public:
+    bool open(const string& directory) {
+        // time.idx first: a record committed after this point is just not seen, while one
+        // whose data is not mapped yet is trimmed off below
+        if (!indexFile.open(directory + "/time.idx") || !dataFile.open(directory + "/messages.dat")) return false;
+        postingsFile.open(directory + "/postings.log");
+        segmentFile.open(directory + "/keywords.seg");
+
+        index = reinterpret_cast<const TimeIndexEntry*>(indexFile.data);
+        count = indexFile.size / sizeof(TimeIndexEntry);
+        while (count > 0 && !complete(count - 1)) count--;
+        postings = reinterpret_cast<const Posting*>(postingsFile.data);
+        postingCount = postingsFile.size / sizeof(Posting);
+        if (segmentFile.size >= 16 && memcmp(segmentFile.data, SEGMENT_MAGIC, 8) == 0) {
+            memcpy(&segmentCovers, segmentFile.data + 8, sizeof(segmentCovers));
+            segment = reinterpret_cast<const Posting*>(segmentFile.data + 16);
+            segmentCount = (segmentFile.size - 16) / sizeof(Posting);
+        }
+        return true;
+    }
+
+    size_t size() const { return count; }
+    uint64_t unindexedPostings() const { return postingCount - min<uint64_t>(segmentCovers, postingCount); }
+
+    // Record contents; empty if the record is out of range or not fully written
+    MessageView message(uint32_t record) const {
+        if (record >= count || !complete(record)) return {};
+        const uint8_t* p = dataFile.data + index[record].offset;
+        MessageRecordHeader header;
+        memcpy(&header, p, sizeof(header));
+        const char* body = reinterpret_cast<const char*>(p + sizeof(header));
+        return {header.timestampMs, static_cast<char>(header.direction),
+                string(body, header.modeLength),
+                string(body + header.modeLength, header.senderLength),
+                string(body + header.modeLength + header.senderLength, header.textLength)};
+    }
+
+    // First record at or after a timestamp (time.idx is sorted)
+    uint32_t lowerBound(uint64_t timestampMs) const {
+        return lower_bound(index, index + count, timestampMs,
+                           [](const TimeIndexEntry& e, uint64_t t) { return e.timestampMs < t; }) - index;
+    }
+
+    // Records in [first, last) with a term: binary search in the compacted segment plus
+    // a scan of postings appended since the last compaction
+    vector<uint32_t> recordsWithTerm(const string& term, uint32_t first, uint32_t last) const {
+        uint32_t hash = termHash(term);
+        vector<uint32_t> records;
+        const Posting* begin = lower_bound(segment, segment + segmentCount, Posting{hash, first},
+                                           [](const Posting& a, const Posting& b) {
+                                               return a.term != b.term ? a.term < b.term : a.record < b.record;
+                                           });
+        for (const Posting* p = begin; p < segment + segmentCount && p->term == hash && p->record < last; ++p) {
+            records.push_back(p->record);
+        }
+        for (uint64_t i = min<uint64_t>(segmentCovers, postingCount); i < postingCount; ++i) {
+            if (postings[i].term == hash && postings[i].record >= first && postings[i].record < last) {
+                records.push_back(postings[i].record);
+            }
+        }
+        sort(records.begin(), records.end());
+        records.erase(unique(records.begin(), records.end()), records.end());
+        return records;
+    }
+
+private:
+    MappedFile dataFile, indexFile, postingsFile, segmentFile;
+
+    // The whole record lies inside the mapped messages.dat
+    bool complete(uint32_t record) const {
+        uint64_t offset = index[record].offset;
+        if (offset > dataFile.size || dataFile.size - offset < sizeof(MessageRecordHeader)) return false;
+        MessageRecordHeader header;
+        memcpy(&header, dataFile.data + offset, sizeof(header));
+        return dataFile.size - offset - sizeof(header) >=
+               static_cast<uint64_t>(header.modeLength) + header.senderLength + header.textLength;
+    }
+
+    const TimeIndexEntry* index = nullptr;
+    const Posting* postings = nullptr;
+    const Posting* segment = nullptr;
+    size_t count = 0;
+    uint64_t postingCount = 0, segmentCount = 0, segmentCovers = 0;
+};
+
+struct Query {
+    uint64_t sinceMs = 0, untilMs = UINT64_MAX;
+    string mode, sender;
+    vector<string> keywords;
+    size_t limit = DEFAULT_LIMIT;
+    bool countOnly = false;
+};
+
+// Accepts the log timestamp format (YYYYmmdd_HHMMSS) or a plain date (YYYYmmdd), local time
+bool parseTime(const string& text, uint64_t& timestampMs) {
+    for (const char* format : {"%Y%m%d_%H%M%S", "%Y%m%d"}) {
+        tm t = {};
+        istringstream in(text);
+        in >> get_time(&t, format);
+        if (!in.fail() && in.peek() == EOF) {
+            t.tm_isdst = -1;
+            timestampMs = static_cast<uint64_t>(mktime(&t)) * 1000;
+            return true;
+        }
+    }
+    return false;
+}
+
+string formatTime(uint64_t timestampMs) {
+    time_t seconds = timestampMs / 1000;
+    tm* ltm = localtime(&seconds);
+    stringstream ss;
+    ss << put_time(ltm, "%Y%m%d_%H%M%S");
+    return ss.str();
+}
+
+// Run a query and return matching record ids in time order. Index terms narrow the
+// candidates; each candidate is then checked exactly (hashes can collide).
+vector<uint32_t> runQuery(const MessageLogReader& reader, const Query& query, size_t& total) {
+    uint32_t first = reader.lowerBound(query.sinceMs);
+    uint32_t last = query.untilMs == UINT64_MAX ? reader.size() : reader.lowerBound(query.untilMs);
+
+    vector<string> terms;
+    if (!query.mode.empty()) terms.push_back("mode:" + lowercase(query.mode));
+    if (!query.sender.empty()) terms.push_back("from:" + lowercase(query.sender));
+    for (const string& keyword : query.keywords) terms.push_back(lowercase(keyword));
+
+    vector<uint32_t> candidates;
+    bool indexed = !terms.empty();
+    for (size_t i = 0; i < terms.size(); ++i) {
+        vector<uint32_t> records = reader.recordsWithTerm(terms[i], first, last);
+        if (i == 0) {
+            candidates = move(records);
+        } else {
+            vector<uint32_t> both;
+            set_intersection(candidates.begin(), candidates.end(), records.begin(), records.end(), back_inserter(both));
+            candidates = move(both);
+        }
+        if (candidates.empty()) break;
+    }
+
+    vector<uint32_t> matches;
+    total = 0;
+    auto check = [&](uint32_t record) {
+        if (indexed) {
+            MessageView message = reader.message(record);
+            if (!query.mode.empty() && lowercase(message.mode) != lowercase(query.mode)) return;
+            if (!query.sender.empty() && lowercase(message.sender) != lowercase(query.sender)) return;
+            if (!query.keywords.empty()) {
+                vector<string> words = messageTerms(message.mode, message.sender, message.text);
+                for (const string& keyword : query.keywords) {
+                    if (!binary_search(words.begin(), words.end(), lowercase(keyword))) return;
+                }
+            }
+        }
+        total++;
+        if (matches.size() < query.limit) matches.push_back(record);
+    };
+    if (indexed) {
+        for (uint32_t record : candidates) check(record);
+    } else {
+        for (uint32_t record = first; record < last; ++record) check(record);
+    }
+    return matches;
+}
+
+// Merge postings appended since the last compaction into the sorted keyword segment
+bool compactStore(const string& directory) {
+    string segmentPath = directory + "/keywords.seg";
+    vector<Posting> merged;
+    uint64_t covers = 0;
+    {
+        MappedFile segment, postings;
+        if (!postings.open(directory + "/postings.log")) return false;
+        uint64_t postingCount = postings.size / sizeof(Posting);
+        const Posting* all = reinterpret_cast<const Posting*>(postings.data);
+
+        vector<Posting> existing;
+        if (segment.open(segmentPath) && segment.size >= 16 && memcmp(segment.data, SEGMENT_MAGIC, 8) == 0) {
+            memcpy(&covers, segment.data + 8, sizeof(covers));
+            const Posting* begin = reinterpret_cast<const Posting*>(segment.data + 16);
+            existing.assign(begin, begin + (segment.size - 16) / sizeof(Posting));
+        }
+        if (covers > postingCount) covers = 0, existing.clear(); // postings were rebuilt
+
+        vector<Posting> tail(all + covers, all + postingCount);
+        auto byTerm = [](const Posting& a, const Posting& b) {
+            return a.term != b.term ? a.term < b.term : a.record < b.record;
+        };
+        sort(tail.begin(), tail.end(), byTerm);
+        merged.resize(existing.size() + tail.size());
+        merge(existing.begin(), existing.end(), tail.begin(), tail.end(), merged.begin(), byTerm);
+        covers = postingCount;
+    }
+
+    string tmpPath = segmentPath + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "wb");
+    if (!out) return false;
+    fwrite(SEGMENT_MAGIC, 1, 8, out);
+    fwrite(&covers, sizeof(covers), 1, out);
+    fwrite(merged.data(), sizeof(Posting), merged.size(), out);
+    fflush(out);
+    fsync(fileno(out));
+    fclose(out);
+    return rename(tmpPath.c_str(), segmentPath.c_str()) == 0;
+}
+
+void printMessages(const MessageLogReader& reader, const vector<uint32_t>& records) {
+    for (uint32_t record : records) {
+        MessageView message = reader.message(record);
+        cout << formatTime(message.timestampMs) << "," << message.direction << "," << message.mode << ","
+             << message.sender << "," << message.text << endl;
+    }
+}
+
+// Ingest synthetic messages into a scratch store and time typical queries
+int runBenchmark(size_t count, const string& directory) {
+    // Only ever wipe an empty directory or a scratch store made by an earlier run
+    if (fs::exists(directory) && (!fs::is_directory(directory) ||
+                                  (!fs::is_empty(directory) && !fs::exists(directory + "/" BENCH_MARKER)))) {
+        cerr << "[BENCH] " << directory << " is not an empty directory or a benchmark store, refusing to overwrite it\n";
+        return 1;
+    }
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+    ofstream(directory + "/" BENCH_MARKER).close();
+    mt19937 rng(42);
+    vector<string> vocabulary;
+    for (int i = 0; i < 2000; ++i) vocabulary.push_back("word" + to_string(i));
+    for (const char* word : {"emergency", "help", "urgent", "danger", "alarm", "fire", "medical"}) vocabulary.push_back(word);
+    geometric_distribution<int> wordRank(0.01);
+    const vector<string> modes = {"TTT", "TTS", "STT", "STS"};
+    const vector<string> senders = {"pipe1", "pipe2", "pipe3", "pipe4", "pipe5", "local"};
+
+    uint64_t startMs = 1700000000000ULL;
+    uint64_t spanMs = 7ULL * 24 * 3600 * 1000; // one week of traffic
+    auto ingestStart = chrono::steady_clock::now();
+    {
+        MessageLogStore store(directory);
+        for (size_t i = 0; i < count; ++i) {
+            string text;
+            int words = 3 + rng() % 10;
+            for (int w = 0; w < words; ++w) {
+                if (w) text += ' ';
+                text += (rng() % 1000 == 0) ? vocabulary[2000 + rng() % 7]
+                                            : vocabulary[min<int>(wordRank(rng), 1999)];
+            }
+            store.append(i % 2 ? MESSAGE_DIRECTION_RECEIVED : MESSAGE_DIRECTION_SENT, modes[rng() % modes.size()],
+                         senders[rng() % senders.size()], text, startMs + spanMs * i / count);
+        }
+    }
+    chrono::duration<double> ingest = chrono::steady_clock::now() - ingestStart;
+    cout << "[BENCH] Ingested " << count << " messages in " << ingest.count() << " s ("
+         << count / ingest.count() << " messages/s)\n";
+
+    auto compactStart = chrono::steady_clock::now();
+    compactStore(directory);
+    chrono::duration<double> compact = chrono::steady_clock::now() - compactStart;
+    cout << "[BENCH] Compacted keyword index in " << compact.count() << " s\n";
+
+    MessageLogReader reader;
+    if (!reader.open(directory)) return 1;
+    uint64_t dayMs = 24ULL * 3600 * 1000;
+    vector<pair<string, Query>> queries(5);
+    queries[0].first = "one day, first 50";
+    queries[0].second.sinceMs = startMs + 2 * dayMs;
+    queries[0].second.untilMs = startMs + 3 * dayMs;
+    queries[1].first = "keyword 'emergency', all time";
+    queries[1].second.keywords = {"emergency"};
+    queries[2].first = "keyword 'emergency' + mode TTT, last day";
+    queries[2].second.keywords = {"emergency"};
+    queries[2].second.mode = "TTT";
+    queries[2].second.sinceMs = startMs + 6 * dayMs;
+    queries[3].first = "sender pipe3, one day, count";
+    queries[3].second.sender = "pipe3";
+    queries[3].second.sinceMs = startMs + 4 * dayMs;
+    queries[3].second.untilMs = startMs + 5 * dayMs;
+    queries[3].second.countOnly = true;
+    queries[4].first = "common keywords 'word1 word2', all time";
+    queries[4].second.keywords = {"word1", "word2"};
+
+    for (auto& [name, query] : queries) {
+        size_t total = 0;
+        auto start = chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_QUERY_RUNS; ++run) runQuery(reader, query, total);
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        cout << "[BENCH] " << name << ": " << total << " matches, " << elapsed.count() / BENCH_QUERY_RUNS
+             << " ms/query\n";
+    }
+    return 0;
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--store <dir>] query [--since <time>] [--until <time>] [--mode <mode>]\n"
+         << "           [--from <sender>] [--keyword <word>]... [--limit <n>] [--count]\n"
+         << "       " << program << " [--store <dir>] compact\n"
+         << "       " << program << " bench <messages> [<scratch dir>]\n"
+         << "  <time> is YYYYmmdd_HHMMSS or YYYYmmdd (local time); --store defaults to " << MESSAGE_STORE_DIR << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    string directory = MESSAGE_STORE_DIR;
+    int i = 1;
+    if (i + 1 < argc && string(argv[i]) == "--store") {
+        directory = argv[i + 1];
+        i += 2;
+    }
+    if (i >= argc) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    string command = argv[i++];
+    if (command == "bench") {
+        if (i >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        size_t count = strtoull(argv[i], nullptr, 10);
+        if (count == 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return runBenchmark(count, i + 1 < argc ? argv[i + 1] : "logs/bench_store");
+    }
+
+    if (command == "compact") {
+        if (!compactStore(directory)) {
+            cerr << "Cannot compact store in " << directory << endl;
+            return 1;
+        }
+        cout << "Keyword index compacted.\n";
+        return 0;
+    }
+
+    if (command != "query") {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Query query;
+    for (; i < argc; ++i) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--since" && hasValue && parseTime(argv[i + 1], query.sinceMs)) {
+            ++i;
+        } else if (arg == "--until" && hasValue && parseTime(argv[i + 1], query.untilMs)) {
+            ++i;
+        } else if (arg == "--mode" && hasValue) {
+            query.mode = argv[++i];
+        } else if (arg == "--from" && hasValue) {
+            query.sender = argv[++i];
+        } else if (arg == "--keyword" && hasValue) {
+            // Split the keyword the way message text is indexed ("Emergency!" -> "emergency")
+            vector<string> words = textTerms(argv[++i]);
+            if (words.empty()) {
+                cerr << "Keyword \"" << argv[i] << "\" has no word of 2+ letters or digits to search for\n";
+                return 1;
+            }
+            query.keywords.insert(query.keywords.end(), words.begin(), words.end());
+        } else if (arg == "--limit" && hasValue) {
+            query.limit = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--count") {
+            query.countOnly = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    MessageLogReader reader;
+    if (!reader.open(directory)) {
+        cerr << "Cannot open message store in " << directory << endl;
+        return 1;
+    }
+    if (reader.unindexedPostings() > 1000000) {
+        cerr << "Note: " << reader.unindexedPostings() << " postings not yet compacted; run '"
+             << argv[0] << " compact' to speed up keyword queries.\n";
+    }
+
+    size_t total = 0;
+    vector<uint32_t> records = runQuery(reader, query, total);
+    if (!query.countOnly) printMessages(reader, records);
+    cout << total << " message(s) matched";
+    if (!query.countOnly && total > records.size()) cout << ", showing first " << records.size();
+    cout << endl;
+    return 0;
+}
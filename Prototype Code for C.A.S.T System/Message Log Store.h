@@ -0,0 +1,256 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+// Append-only message log with a time index and an inverted keyword index.
+//
+// <dir>/messages.dat  records: MessageRecordHeader, mode, sender, text
+// <dir>/time.idx      one TimeIndexEntry per record, in record order (record id = entry number)
+// <dir>/postings.log  one Posting per distinct term of each record, appended as messages land
+// <dir>/keywords.seg  postings sorted by term, built by the query tool's "compact" command
+//
+// A record is committed once its time.idx entry is written; opening the store
+// drops anything written after the last committed record and re-creates any
+// postings lost in a crash. Readers mmap the files (see Message Log Query Tool.cpp).
+// Each program appends to its own directory (the receiver to MESSAGE_STORE_DIR, the
+// transmitters to logs/store_<mode>); <dir>/store.lock is held with flock() so a
+// second writer on the same directory is refused.
+
+#define MESSAGE_STORE_DIR "logs/store"
+#define MESSAGE_DIRECTION_RECEIVED 'R'
+#define MESSAGE_DIRECTION_SENT 'S'
+
+struct MessageRecordHeader {
+    uint64_t timestampMs;   // unix epoch milliseconds, never decreasing within a store
+    uint32_t textLength;
+    uint16_t modeLength;
+    uint16_t senderLength;
+    uint8_t direction;      // MESSAGE_DIRECTION_RECEIVED / MESSAGE_DIRECTION_SENT
+    uint8_t reserved[7];
+};
+static_assert(sizeof(MessageRecordHeader) == 24, "record header layout");
+
+struct TimeIndexEntry {
+    uint64_t timestampMs;
+    uint64_t offset;        // record offset in messages.dat
+};
+
+struct Posting {
+    uint32_t term;          // termHash() of a term
+    uint32_t record;
+};
+
+inline uint32_t termHash(const std::string& term) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (unsigned char c : term) hash = (hash ^ c) * 16777619u;
+    return hash;
+}
+
+inline std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+// Words of a text as indexed: lowercase runs of 2+ letters or digits
+inline std::vector<std::string> textTerms(const std::string& text) {
+    std::vector<std::string> terms;
+    std::string word;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size() && isalnum(static_cast<unsigned char>(text[i]))) {
+            word += static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
+        } else {
+            if (word.size() >= 2) terms.push_back(word);
+            word.clear();
+        }
+    }
+    return terms;
+}
+
+// Distinct index terms of a message: its words plus mode:<mode> and from:<sender>
+inline std::vector<std::string> messageTerms(const std::string& mode, const std::string& sender, const std::string& text) {
+    std::vector<std::string> terms = textTerms(text);
+    terms.push_back("mode:" + lowercase(mode));
+    terms.push_back("from:" + lowercase(sender));
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    return terms;
+}
+
+// Single-writer appender, locked to one process per directory
+class MessageLogStore {
+public:
+    explicit MessageLogStore(const std::string& directory = MESSAGE_STORE_DIR)
+        : dataPath(directory + "/messages.dat"), indexPath(directory + "/time.idx"),
+          postingsPath(directory + "/postings.log") {
+        std::filesystem::create_directories(directory);
+        lockFd = open((directory + "/store.lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if (lockFd < 0 || flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+            std::cerr << "[STORE] " << directory << " is in use by another program, messages will not be stored\n";
+            return;
+        }
+        recover();
+        data = fopen(dataPath.c_str(), "ab");
+        index = fopen(indexPath.c_str(), "ab");
+        postings = fopen(postingsPath.c_str(), "ab");
+        if (!data || !index || !postings) std::cerr << "[STORE] Cannot open message store in " << directory << std::endl;
+        reindexFrom(lastIndexed);
+    }
+
+    ~MessageLogStore() {
+        if (data) fclose(data);
+        if (index) fclose(index);
+        if (postings) fclose(postings);
+        if (lockFd >= 0) close(lockFd);
+    }
+
+    // Append one message and its index entries
+    bool append(char direction, const std::string& mode, const std::string& sender, const std::string& text,
+                uint64_t timestampMs = 0) {
+        if (!data || !index || !postings) return false;
+        if (timestampMs == 0) {
+            timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        timestampMs = std::max(timestampMs, lastTimestampMs); // keep time.idx sorted
+
+        MessageRecordHeader header = {};
+        header.timestampMs = timestampMs;
+        header.textLength = static_cast<uint32_t>(text.size());
+        header.modeLength = static_cast<uint16_t>(mode.size());
+        header.senderLength = static_cast<uint16_t>(sender.size());
+        header.direction = static_cast<uint8_t>(direction);
+
+        TimeIndexEntry entry = {timestampMs, dataSize};
+        bool ok = fwrite(&header, sizeof(header), 1, data) == 1 &&
+                  fwrite(mode.data(), 1, mode.size(), data) == mode.size() &&
+                  fwrite(sender.data(), 1, sender.size(), data) == sender.size() &&
+                  fwrite(text.data(), 1, text.size(), data) == text.size() &&
+                  fflush(data) == 0 &&
+                  fwrite(&entry, sizeof(entry), 1, index) == 1 && fflush(index) == 0;
+        if (!ok) {
+            std::cerr << "[STORE] Failed to append message\n";
+            return false;
+        }
+
+        dataSize += sizeof(header) + mode.size() + sender.size() + text.size();
+        lastTimestampMs = timestampMs;
+        writePostings(recordCount++, mode, sender, text);
+        return true;
+    }
+
+    uint32_t size() const { return recordCount; }
+
+private:
+    std::string dataPath, indexPath, postingsPath;
+    FILE* data = nullptr;
+    FILE* index = nullptr;
+    FILE* postings = nullptr;
+    int lockFd = -1;
+    uint64_t dataSize = 0;
+    uint64_t lastTimestampMs = 0;
+    uint32_t recordCount = 0;
+    uint32_t lastIndexed = 0;   // records below this have complete postings
+
+    static uint64_t fileSize(const std::string& path) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(path, error);
+        return error ? 0 : size;
+    }
+
+    static void truncateFile(const std::string& path, uint64_t size) {
+        if (std::filesystem::exists(path)) std::filesystem::resize_file(path, size);
+    }
+
+    void writePostings(uint32_t record, const std::string& mode, const std::string& sender, const std::string& text) {
+        std::vector<Posting> entries;
+        for (const std::string& term : messageTerms(mode, sender, text)) entries.push_back({termHash(term), record});
+        fwrite(entries.data(), sizeof(Posting), entries.size(), postings);
+        fflush(postings);
+    }
+
+    // Trim torn tails: data past the last committed record, postings past the last record
+    void recover() {
+        if (!std::filesystem::exists(dataPath)) return;
+        uint64_t indexSize = fileSize(indexPath) / sizeof(TimeIndexEntry) * sizeof(TimeIndexEntry);
+        uint64_t dataBytes = fileSize(dataPath);
+
+        FILE* in = fopen(indexPath.c_str(), "rb");
+        while (in && indexSize > 0) {
+            // The last index entry must point at a complete record
+            TimeIndexEntry entry;
+            MessageRecordHeader header;
+            fseek(in, static_cast<long>(indexSize - sizeof(entry)), SEEK_SET);
+            FILE* records = fopen(dataPath.c_str(), "rb");
+            bool complete = fread(&entry, sizeof(entry), 1, in) == 1 && records &&
+                            fseek(records, static_cast<long>(entry.offset), SEEK_SET) == 0 &&
+                            fread(&header, sizeof(header), 1, records) == 1 &&
+                            entry.offset + sizeof(header) + header.modeLength + header.senderLength +
+                                header.textLength <= dataBytes;
+            if (records) fclose(records);
+            if (complete) {
+                dataSize = entry.offset + sizeof(header) + header.modeLength + header.senderLength + header.textLength;
+                lastTimestampMs = entry.timestampMs;
+                break;
+            }
+            indexSize -= sizeof(entry);
+        }
+        if (in) fclose(in);
+
+        recordCount = static_cast<uint32_t>(indexSize / sizeof(TimeIndexEntry));
+        if (recordCount == 0) dataSize = 0;
+        truncateFile(indexPath, indexSize);
+        truncateFile(dataPath, dataSize);
+
+        // Drop postings of uncommitted records, then all postings of the last indexed record
+        // (a crash may have cut its postings short) so it is indexed again in full
+        uint64_t postingsSize = fileSize(postingsPath) / sizeof(Posting) * sizeof(Posting);
+        FILE* post = fopen(postingsPath.c_str(), "rb");
+        bool found = false;
+        while (post && postingsSize > 0) {
+            Posting last;
+            fseek(post, static_cast<long>(postingsSize - sizeof(last)), SEEK_SET);
+            if (fread(&last, sizeof(last), 1, post) != 1) break;
+            if (found && last.record != lastIndexed) break;
+            if (!found && last.record < recordCount) {
+                found = true;
+                lastIndexed = last.record;
+            }
+            postingsSize -= sizeof(last);
+        }
+        if (post) fclose(post);
+        truncateFile(postingsPath, postingsSize);
+    }
+
+    // Re-create postings for committed records that lost them in a crash
+    void reindexFrom(uint32_t first) {
+        if (first >= recordCount || !postings) return;
+        FILE* in = fopen(indexPath.c_str(), "rb");
+        FILE* records = fopen(dataPath.c_str(), "rb");
+        for (uint32_t record = first; in && records && record < recordCount; ++record) {
+            TimeIndexEntry entry;
+            MessageRecordHeader header;
+            fseek(in, static_cast<long>(record * sizeof(entry)), SEEK_SET);
+            if (fread(&entry, sizeof(entry), 1, in) != 1) break;
+            fseek(records, static_cast<long>(entry.offset), SEEK_SET);
+            if (fread(&header, sizeof(header), 1, records) != 1) break;
+            std::string mode(header.modeLength, '\0'), sender(header.senderLength, '\0'), text(header.textLength, '\0');
+            if (fread(&mode[0], 1, mode.size(), records) != mode.size() ||
+                fread(&sender[0], 1, sender.size(), records) != sender.size() ||
+                fread(&text[0], 1, text.size(), records) != text.size()) break;
+            writePostings(record, mode, sender, text);
+        }
+        if (in) fclose(in);
+        if (records) fclose(records);
+    }
+};
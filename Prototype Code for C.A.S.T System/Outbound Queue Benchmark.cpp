@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
+#include "Outbound Queue.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Simulated RF24 link, no radio needed
+#define PACKET_SIZE 32
+#define FAILED_WRITE_MS 60      // setRetries(15, 15): 15 retransmissions before write() gives up
+
+// Simulated link: packets take packetMs each while the link is up, a write fails after
+// FAILED_WRITE_MS while it is down. Same callback shape as the transmitters' send functions.
+struct SimulatedLink {
+    chrono::steady_clock::time_point upAt;
+    double packetMs;
+    atomic<size_t> failures{0};
+    vector<double> latenciesMs;                     // queued -> delivered, delivery thread only
+    chrono::steady_clock::time_point firstDelivery;
+
+    bool write() {
+        if (chrono::steady_clock::now() < upAt) {
+            this_thread::sleep_for(chrono::milliseconds(FAILED_WRITE_MS));
+            return false;
+        }
+        this_thread::sleep_for(chrono::microseconds(static_cast<long>(packetMs * 1000)));
+        return true;
+    }
+
+    size_t send(const vector<OutboundMessage>& batch) {
+        size_t delivered = 0;
+        for (const OutboundMessage& message : batch) {
+            size_t packets = 2 + (message.payload.size() + PACKET_SIZE - 1) / PACKET_SIZE; // mode + EOF
+            for (size_t i = 0; i < packets; ++i) {
+                if (!write()) {
+                    failures++;
+                    return delivered;
+                }
+            }
+            auto now = chrono::steady_clock::now();
+            if (latenciesMs.empty()) firstDelivery = now;
+            latenciesMs.push_back(chrono::duration<double, milli>(now - message.queued).count());
+            delivered++;
+        }
+        return delivered;
+    }
+};
+
+double percentile(vector<double> values, double p) {
+    if (values.empty()) return 0;
+    sort(values.begin(), values.end());
+    return values[min(values.size() - 1, static_cast<size_t>(p * values.size()))];
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [messages] [link down seconds] [packet ms]\n"
+         << "  Queues messages while a simulated link is down, then reports how fast the outbox drains it\n"
+         << "  (defaults: 300 messages, 10 s down, 1 ms per packet)\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = 300;
+    double downSeconds = 10, packetMs = 1;
+    if (argc > 4 || (argc > 1 && (count = strtoul(argv[1], nullptr, 10)) == 0) ||
+        (argc > 2 && (downSeconds = atof(argv[2])) < 0) || (argc > 3 && (packetMs = atof(argv[3])) <= 0)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Private queue directory, removed afterwards
+    char pattern[] = "/tmp/cast_outbox_bench_XXXXXX";
+    if (!mkdtemp(pattern)) {
+        cerr << "[BENCH] Cannot create a temporary directory\n";
+        return 1;
+    }
+    string directory = pattern;
+
+    SimulatedLink link;
+    link.packetMs = packetMs;
+    auto start = chrono::steady_clock::now();
+    link.upAt = start + chrono::milliseconds(static_cast<long>(downSeconds * 1000));
+    {
+        OutboundQueue outbox(directory, [&link](const vector<OutboundMessage>& batch) { return link.send(batch); });
+        if (!outbox.isOpen()) return 1;
+        outbox.start();
+
+        // Queue the burst while the link is down, spread over the first half of the outage
+        auto enqueueStart = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            string text = "Simulated message " + to_string(i) + " queued while the receiver is out of range";
+            outbox.enqueue("TTT", text, i % 50 == 49);
+            this_thread::sleep_until(enqueueStart + chrono::microseconds(
+                static_cast<long>(downSeconds * 500000 * (i + 1) / count)));
+        }
+        cout << "[BENCH] Queued " << count << " messages while the link is down\n";
+
+        outbox.waitUntilDrained();
+    }
+    auto end = chrono::steady_clock::now();
+    fs::remove_all(directory);
+
+    chrono::duration<double> recovery = link.firstDelivery - link.upAt;
+    chrono::duration<double> drain = end - link.firstDelivery;
+    cout << "[BENCH] Link down " << downSeconds << " s, " << link.failures << " failed transfer attempts\n"
+         << "[BENCH] First delivery " << recovery.count() << " s after the link came up (backoff)\n"
+         << "[BENCH] Drained " << link.latenciesMs.size() << " messages in " << drain.count() << " s ("
+         << link.latenciesMs.size() / drain.count() << " messages/s at " << packetMs << " ms per packet)\n"
+         << "[BENCH] Queue latency p50 " << percentile(link.latenciesMs, 0.5) / 1000 << " s, p99 "
+         << percentile(link.latenciesMs, 0.99) / 1000 << " s, max "
+         << percentile(link.latenciesMs, 1.0) / 1000 << " s\n";
+    return link.latenciesMs.size() == count ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <set>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+// Durable store-and-forward queue for outgoing transmissions.
+//
+// Messages are appended to <dir>/queue.log before the transmitter tries to send
+// them, and <dir>/queue.ack holds the log offset up to which messages have been
+// delivered, followed by the end offsets of any later records already delivered
+// out of order (urgent messages jump ahead of normal ones). A background thread
+// drains the queue in batches, backing off while the link is down, so nothing is
+// lost if the receiver is out of range or the transmitter restarts.
+//
+// Each transmitter owns its queue directory; <dir>/queue.lock is held with flock()
+// for the life of the queue so a second process cannot append to the same log.
+//
+// queue.log record: uint32 mode length, uint32 payload length, uint32 flags, uint32 FNV-1a checksum, mode, payload
+
+#define OUTBOX_MAX_BATCH 32
+#define OUTBOX_BACKOFF_MIN_MS 1500   // longer than the receiver's 1 s abandoned-transfer timeout
+#define OUTBOX_BACKOFF_MAX_MS 60000
+#define OUTBOX_FLAG_URGENT 1
+
+struct OutboundMessage {
+    std::string mode;      // mode identifier sent ahead of the payload (TTT, TTS, STT, STS)
+    std::string payload;   // text message or encoded Codec2 frames
+    bool urgent;           // delivered ahead of normal messages
+    uint64_t offset;       // log offset of this record
+    uint64_t endOffset;    // log offset just past this record
+    std::chrono::steady_clock::time_point queued;
+};
+
+class OutboundQueue {
+public:
+    // Sends a batch in order and returns how many messages were delivered
+    using SendBatch = std::function<size_t(const std::vector<OutboundMessage>&)>;
+
+    OutboundQueue(const std::string& directory, SendBatch send)
+        : logPath(directory + "/queue.log"), ackPath(directory + "/queue.ack"), send(send) {
+        std::filesystem::create_directories(directory);
+        lockFd = open((directory + "/queue.lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if (lockFd < 0 || flock(lockFd, LOCK_EX | LOCK_NB) != 0) {
+            std::cerr << "[OUTBOX] " << directory << " is in use by another transmitter" << std::endl;
+            return;
+        }
+        load();
+        log = fopen(logPath.c_str(), "ab");
+        if (!log) std::cerr << "[OUTBOX] Cannot open " << logPath << std::endl;
+    }
+
+    ~OutboundQueue() {
+        stop();
+        if (log) fclose(log);
+        if (lockFd >= 0) close(lockFd);
+    }
+
+    // False if the queue directory is locked by another process or the log cannot be opened
+    bool isOpen() const { return log != nullptr; }
+
+    // Start background delivery
+    void start() {
+        running = true;
+        worker = std::thread(&OutboundQueue::run, this);
+    }
+
+    // Stop background delivery; undelivered messages stay on disk
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        changed.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    // Persist a message and hand it to the delivery thread; urgent messages go
+    // ahead of every normal message still waiting
+    bool enqueue(const std::string& mode, const std::string& payload, bool urgent = false) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!log) return false;
+
+        uint32_t flags = urgent ? OUTBOX_FLAG_URGENT : 0;
+        uint32_t header[4] = {static_cast<uint32_t>(mode.size()), static_cast<uint32_t>(payload.size()),
+                              flags, checksum(mode, payload, flags)};
+        bool ok = fwrite(header, sizeof(header), 1, log) == 1 &&
+                  fwrite(mode.data(), 1, mode.size(), log) == mode.size() &&
+                  fwrite(payload.data(), 1, payload.size(), log) == payload.size() &&
+                  fflush(log) == 0 && fsync(fileno(log)) == 0;
+        if (!ok) {
+            std::cerr << "[OUTBOX] Failed to write " << logPath << std::endl;
+            return false;
+        }
+
+        uint64_t offset = logSize;
+        logSize += sizeof(header) + mode.size() + payload.size();
+        insert({mode, payload, urgent, offset, logSize, std::chrono::steady_clock::now()});
+        if (urgent) urgentArrived = true;
+        changed.notify_all();
+        return true;
+    }
+
+    // True when an urgent message arrived since the current batch was taken; the sender may
+    // stop early so it goes out next
+    bool urgentWaiting() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return urgentArrived;
+    }
+
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    // Block until every queued message has been delivered
+    void waitUntilDrained() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return queue.empty() || !running; });
+    }
+
+private:
+    std::string logPath, ackPath;
+    SendBatch send;
+    FILE* log = nullptr;
+    int lockFd = -1;
+    uint64_t logSize = 0;
+    uint64_t ackOffset = 0;
+    std::set<uint64_t> deliveredAhead;   // end offsets delivered past ackOffset
+    std::deque<OutboundMessage> queue;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread worker;
+    bool running = false;
+    bool sending = false;
+    bool urgentArrived = false;
+
+    static uint32_t checksum(const std::string& mode, const std::string& payload, uint32_t flags) {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : mode) hash = (hash ^ c) * 16777619u;
+        for (unsigned char c : payload) hash = (hash ^ c) * 16777619u;
+        return (hash ^ flags) * 16777619u;
+    }
+
+    // Urgent messages queue behind other urgent ones but ahead of normal messages
+    void insert(const OutboundMessage& message) {
+        auto pos = queue.end();
+        if (message.urgent) {
+            pos = std::find_if(queue.begin(), queue.end(), [](const OutboundMessage& m) { return !m.urgent; });
+        }
+        queue.insert(pos, message);
+    }
+
+    // Read the ack checkpoint and reload every record after it, dropping a torn tail
+    void load() {
+        std::ifstream ack(ackPath);
+        ack >> ackOffset;
+        for (uint64_t end; ack >> end;) deliveredAhead.insert(end);
+
+        std::ifstream in(logPath, std::ios::binary);
+        uint64_t offset = 0;
+        uint32_t header[4];
+        auto now = std::chrono::steady_clock::now();
+        while (in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            std::string mode(header[0], '\0'), payload(header[1], '\0');
+            if (!in.read(&mode[0], mode.size()) || !in.read(&payload[0], payload.size()) ||
+                checksum(mode, payload, header[2]) != header[3]) {
+                break;
+            }
+            uint64_t end = offset + sizeof(header) + mode.size() + payload.size();
+            if (end > ackOffset && !deliveredAhead.count(end)) {
+                insert({mode, payload, (header[2] & OUTBOX_FLAG_URGENT) != 0, offset, end, now});
+            }
+            offset = end;
+        }
+        in.close();
+
+        logSize = offset;
+        if (ackOffset > logSize || (!deliveredAhead.empty() && *deliveredAhead.rbegin() > logSize)) {
+            // The ack points past the surviving log; new records will reuse those offsets,
+            // so persist the lowered ack before anything else is appended
+            ackOffset = std::min(ackOffset, logSize);
+            deliveredAhead.erase(deliveredAhead.upper_bound(logSize), deliveredAhead.end());
+            checkpoint();
+        }
+        if (std::filesystem::exists(logPath) && std::filesystem::file_size(logPath) != logSize) {
+            std::cerr << "[OUTBOX] Discarding torn record at end of " << logPath << std::endl;
+            std::filesystem::resize_file(logPath, logSize);
+        }
+        if (!queue.empty()) std::cout << "[OUTBOX] " << queue.size() << " undelivered message(s) restored.\n";
+        compact();
+    }
+
+    // Atomically record how much of the log has been delivered
+    void checkpoint() {
+        std::string tmpPath = ackPath + ".tmp";
+        FILE* ack = fopen(tmpPath.c_str(), "w");
+        if (!ack) return;
+        fprintf(ack, "%llu\n", static_cast<unsigned long long>(ackOffset));
+        for (uint64_t end : deliveredAhead) fprintf(ack, "%llu\n", static_cast<unsigned long long>(end));
+        fflush(ack);
+        fsync(fileno(ack));
+        fclose(ack);
+        std::rename(tmpPath.c_str(), ackPath.c_str());
+    }
+
+    // Once everything is delivered, truncate the log (before resetting the ack, so a
+    // crash in between can never resend delivered messages)
+    void compact() {
+        if (!queue.empty() || logSize == 0) return;
+        std::filesystem::resize_file(logPath, 0);
+        logSize = ackOffset = 0;
+        deliveredAhead.clear();
+        checkpoint();
+    }
+
+    // Record delivered messages: everything before the oldest undelivered record is acked,
+    // later deliveries are remembered individually
+    void acknowledge(const std::vector<OutboundMessage>& delivered) {
+        for (const OutboundMessage& message : delivered) {
+            deliveredAhead.insert(message.endOffset);
+            queue.erase(std::find_if(queue.begin(), queue.end(), [&](const OutboundMessage& m) {
+                return m.offset == message.offset;
+            }));
+        }
+
+        uint64_t oldestPending = logSize;
+        for (const OutboundMessage& message : queue) oldestPending = std::min(oldestPending, message.offset);
+        ackOffset = oldestPending;
+        deliveredAhead.erase(deliveredAhead.begin(), deliveredAhead.upper_bound(ackOffset));
+        checkpoint();
+    }
+
+    // Delivery thread: send pending messages in batches, backing off while the link is down
+    void run() {
+        int backoffMs = OUTBOX_BACKOFF_MIN_MS;
+        size_t drained = 0;
+        auto drainStart = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running) {
+            changed.wait(lock, [this] { return !queue.empty() || !running; });
+            if (!running) break;
+
+            size_t count = std::min(queue.size(), static_cast<size_t>(OUTBOX_MAX_BATCH));
+            std::vector<OutboundMessage> batch(queue.begin(), queue.begin() + count);
+            if (drained == 0) drainStart = std::chrono::steady_clock::now();
+
+            sending = true;
+            urgentArrived = false;
+            lock.unlock();
+            size_t delivered = send(batch);
+            lock.lock();
+            sending = false;
+
+            if (delivered > 0) {
+                acknowledge(std::vector<OutboundMessage>(batch.begin(), batch.begin() + delivered));
+                drained += delivered;
+                backoffMs = OUTBOX_BACKOFF_MIN_MS;
+            }
+
+            if (queue.empty()) {
+                if (drained > 1) {
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - drainStart;
+                    std::cout << "[OUTBOX] Drained " << drained << " messages in " << elapsed.count()
+                              << " s (" << drained / elapsed.count() << " messages/s)\n";
+                }
+                drained = 0;
+                compact();
+                changed.notify_all();
+            } else if (delivered < count && !urgentArrived) {
+                // Link down - keep messages and retry later. An urgent message cuts the wait
+                // short, though never below OUTBOX_BACKOFF_MIN_MS, and restarts the backoff
+                std::cout << "[OUTBOX] Delivery failed, " << queue.size() << " message(s) queued, retrying in "
+                          << backoffMs / 1000.0 << " s\n";
+                auto retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(backoffMs);
+                changed.wait_for(lock, std::chrono::milliseconds(OUTBOX_BACKOFF_MIN_MS), [this] { return !running; });
+                changed.wait_until(lock, retryAt, [this] { return !running || urgentArrived; });
+                if (urgentArrived) {
+                    std::cout << "[OUTBOX] Urgent message queued, retrying now\n";
+                    backoffMs = OUTBOX_BACKOFF_MIN_MS;
+                } else {
+                    backoffMs = std::min(backoffMs * 2, OUTBOX_BACKOFF_MAX_MS);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,258 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "Relay Tree.h"
+
+using namespace std;
+
+// Modelled relay tree, no radio needed. Hop costs are a model, not measurements:
+// pass the "hop latency avg" a real relay prints (Complete Receiver --relay) as --hop-us
+// to use measured figures instead.
+#define PACKET_SIZE 32
+#define STS_HEADER 4            // length (0xFF = EOF), origin, uint16 sequence (see Speech to Speech Transmitter)
+#define SIM_HOP_AIRTIME_US 400  // modelled hop: RX/TX turnaround plus a 32 byte write and ack at 2 Mbps
+#define SIM_DIRECT_PERCENT 50   // packets the base also hears straight from the transmitter
+#define CAPTURE_MAGIC "CASTCAP1"
+#define CAPTURE_VERSION 1
+
+// One record of a capture file (layout in Complete Receiver.cpp, Packet Capture & Replay)
+struct CapturedPacket {
+    uint64_t timestampNs;
+    uint8_t pipe;
+    uint8_t len;
+    uint8_t data[PACKET_SIZE];
+};
+
+// A copy of a transmitted packet reaching the base, directly or through the relays
+struct Arrival {
+    CapturedPacket packet;
+    size_t source;              // index of the transmitted packet
+    bool relayed;
+};
+
+struct SimulatedHop {
+    uint16_t node;              // relay doing the forwarding
+    uint8_t pipe;               // pipe it hears the previous hop on (0 = transmitter, --access)
+    DedupHistory history;
+    uint64_t busyUntilNs = 0;   // radio still sending an earlier packet
+    uint64_t packets = 0;
+    double totalLatencyUs = 0, maxLatencyUs = 0;
+};
+
+bool readCapture(const string& filename, vector<CapturedPacket>& packets, uint64_t& startEpochNs) {
+    ifstream in(filename, ios::binary);
+    char magic[8];
+    uint32_t version = 0, snaplen = 0;
+    in.read(magic, 8);
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&snaplen), sizeof(snaplen));
+    in.read(reinterpret_cast<char*>(&startEpochNs), sizeof(startEpochNs));
+    if (!in || memcmp(magic, CAPTURE_MAGIC, 8) != 0 || version != CAPTURE_VERSION) return false;
+
+    CapturedPacket packet;
+    char pipe, length;
+    while (in.read(reinterpret_cast<char*>(&packet.timestampNs), sizeof(packet.timestampNs)) &&
+           in.get(pipe) && in.get(length)) {
+        packet.pipe = static_cast<uint8_t>(pipe);
+        packet.len = static_cast<uint8_t>(length);
+        if (packet.len > PACKET_SIZE || !in.read(reinterpret_cast<char*>(packet.data), packet.len)) {
+            cerr << "[SIM] Truncated or corrupt record, stopping.\n";
+            break;
+        }
+        packets.push_back(packet);
+    }
+    return true;
+}
+
+bool writeCapture(const string& filename, const vector<CapturedPacket>& packets, uint64_t startEpochNs) {
+    ofstream out(filename, ios::binary | ios::trunc);
+    uint32_t version = CAPTURE_VERSION;
+    uint32_t snaplen = PACKET_SIZE;
+    out.write(CAPTURE_MAGIC, 8);
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char*>(&snaplen), sizeof(snaplen));
+    out.write(reinterpret_cast<const char*>(&startEpochNs), sizeof(startEpochNs));
+    for (const CapturedPacket& packet : packets) {
+        out.write(reinterpret_cast<const char*>(&packet.timestampNs), sizeof(packet.timestampNs));
+        out.put(static_cast<char>(packet.pipe));
+        out.put(static_cast<char>(packet.len));
+        out.write(reinterpret_cast<const char*>(packet.data), packet.len);
+    }
+    return static_cast<bool>(out);
+}
+
+// Regression transfer: an STS recording whose middle is 203 identical silence packets,
+// written back to back one hop airtime apart. Every packet must reach the base exactly once.
+vector<CapturedPacket> silenceTransfer(uint64_t gapNs) {
+    vector<CapturedPacket> packets;
+    uint64_t timestampNs = 0;
+    auto add = [&](const uint8_t* data, uint8_t len) {
+        CapturedPacket packet = {timestampNs, 1, len, {}};
+        memcpy(packet.data, data, len);
+        packets.push_back(packet);
+        timestampNs += gapNs;
+    };
+    add(reinterpret_cast<const uint8_t*>("STS"), 3);
+    add(reinterpret_cast<const uint8_t*>("EOF"), 4);
+
+    uint16_t sequence = 0;
+    for (int i = 0; i <= 260; ++i) {
+        uint8_t packet[PACKET_SIZE] = {};
+        bool eof = i == 260;
+        packet[0] = eof ? 0xFF : PACKET_SIZE - STS_HEADER;
+        packet[1] = 0x5A;
+        packet[2] = sequence & 0xFF;
+        packet[3] = sequence >> 8;
+        sequence++;
+        for (int k = STS_HEADER; k < PACKET_SIZE; ++k) {
+            packet[k] = eof ? 0xEE : (i >= 30 && i < 233) ? 0x11 : static_cast<uint8_t>(i * 7 + k);
+        }
+        add(packet, PACKET_SIZE);
+    }
+    return packets;
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " <node> [--capture <file>] [--out <file>] [--hop-us <us>] [--direct <percent>]\n"
+         << "  Forwards a transmitter's packets from relay <node> (octal tree id) to the base and checks the\n"
+         << "  base's duplicate filter delivers each one exactly once\n"
+         << "  --capture <file>   packets as sent by the transmitter (default: built-in STS transfer with repeated frames)\n"
+         << "  --out <file>       write what the base hears as a capture for Complete Receiver --replay\n"
+         << "  --hop-us <us>      time per relay hop (default " << SIM_HOP_AIRTIME_US << ", modelled)\n"
+         << "  --direct <percent> packets the base also hears directly (default " << SIM_DIRECT_PERCENT << ")\n";
+}
+
+int main(int argc, char* argv[]) {
+    uint16_t leaf = 0;
+    string sourceFile, outFile;
+    double hopUs = SIM_HOP_AIRTIME_US;
+    int directPercent = SIM_DIRECT_PERCENT;
+    if (argc < 2 || !parseNode(argv[1], leaf)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--capture" && i + 1 < argc) {
+            sourceFile = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outFile = argv[++i];
+        } else if (arg == "--hop-us" && i + 1 < argc) {
+            hopUs = atof(argv[++i]);
+        } else if (arg == "--direct" && i + 1 < argc) {
+            directPercent = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (hopUs <= 0 || directPercent < 0 || directPercent > 100) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    uint64_t hopNs = static_cast<uint64_t>(hopUs * 1000);
+
+    vector<CapturedPacket> sent;
+    uint64_t startEpochNs = 0;
+    if (sourceFile.empty()) {
+        sent = silenceTransfer(hopNs);
+    } else if (!readCapture(sourceFile, sent, startEpochNs)) {
+        cerr << "[SIM] Cannot open capture file: " << sourceFile << endl;
+        return 1;
+    }
+
+    // Relay chain from the leaf to the base, following each node's uplink address
+    vector<SimulatedHop> hops;
+    uint8_t pipe = 0;
+    for (uint16_t node = leaf; node != 0; node = parentNode(node)) {
+        SimulatedHop hop;
+        hop.node = node;
+        hop.pipe = pipe;
+        hops.push_back(hop);
+        pipe = static_cast<uint8_t>((uplinkAddress(node) & 0xFF) - 0x77);
+    }
+    uint8_t basePipe = pipe;
+
+    // Every packet goes up the chain; some are also heard directly on the base's own pipe
+    mt19937 rng(1);
+    vector<Arrival> arrivals;
+    for (size_t i = 0; i < sent.size(); ++i) {
+        if (static_cast<int>(rng() % 100) < directPercent) arrivals.push_back({sent[i], i, false});
+
+        Arrival relayed = {sent[i], i, true};
+        bool dropped = false;
+        for (SimulatedHop& hop : hops) {
+            uint64_t receivedNs = relayed.packet.timestampNs;
+            if (isDuplicate(hop.history, hop.pipe, receivedNs, relayed.packet.data, relayed.packet.len)) {
+                dropped = true;
+                break;
+            }
+            uint64_t departNs = max(receivedNs, hop.busyUntilNs) + hopNs;
+            double latencyUs = (departNs - receivedNs) / 1000.0;
+            hop.busyUntilNs = departNs;
+            hop.packets++;
+            hop.totalLatencyUs += latencyUs;
+            hop.maxLatencyUs = max(hop.maxLatencyUs, latencyUs);
+            relayed.packet.timestampNs = departNs;
+        }
+        relayed.packet.pipe = basePipe;
+        if (!dropped) arrivals.push_back(relayed);
+    }
+    stable_sort(arrivals.begin(), arrivals.end(), [](const Arrival& a, const Arrival& b) {
+        return a.packet.timestampNs < b.packet.timestampNs;
+    });
+
+    // The base's duplicate filter, exactly as in receivePacket
+    DedupHistory base;
+    vector<size_t> deliveries(sent.size(), 0);
+    vector<CapturedPacket> heard;
+    size_t duplicates = 0, reordered = 0, nextSource = 0;
+    double totalEndToEndUs = 0, maxEndToEndUs = 0;
+    for (const Arrival& arrival : arrivals) {
+        heard.push_back(arrival.packet);
+        if (isDuplicate(base, arrival.packet.pipe, arrival.packet.timestampNs, arrival.packet.data, arrival.packet.len)) {
+            duplicates++;
+            continue;
+        }
+        deliveries[arrival.source]++;
+        if (arrival.source < nextSource) reordered++;
+        nextSource = max(nextSource, arrival.source + 1);
+        double endToEndUs = (arrival.packet.timestampNs - sent[arrival.source].timestampNs) / 1000.0;
+        totalEndToEndUs += endToEndUs;
+        maxEndToEndUs = max(maxEndToEndUs, endToEndUs);
+    }
+
+    size_t lost = count(deliveries.begin(), deliveries.end(), 0);
+    size_t repeated = count_if(deliveries.begin(), deliveries.end(), [](size_t n) { return n > 1; });
+    size_t delivered = sent.size() - lost;
+
+    cout << "[SIM] Transmitter behind relay 0" << oct << leaf << dec << ", " << hops.size() << " hop(s) to the base, "
+         << hopUs << " us per hop (" << (hopUs == SIM_HOP_AIRTIME_US ? "modelled" : "given") << ")\n";
+    for (size_t i = 0; i < hops.size(); ++i) {
+        const SimulatedHop& hop = hops[i];
+        cout << "[SIM] Hop " << i + 1 << ": node 0" << oct << hop.node << " -> 0" << parentNode(hop.node) << dec
+             << " (pipe " << int(hop.pipe) << " in), " << hop.packets << " packets, modelled latency avg "
+             << (hop.packets ? hop.totalLatencyUs / hop.packets : 0) << " us, max " << hop.maxLatencyUs << " us\n";
+    }
+    cout << "[SIM] " << sent.size() << " packets sent, " << arrivals.size() << " arrivals at the base, "
+         << duplicates << " duplicates dropped\n"
+         << "[SIM] " << delivered << " delivered, " << lost << " lost to the duplicate filter, "
+         << repeated << " delivered twice, " << reordered << " out of order\n"
+         << "[SIM] Modelled end-to-end latency avg " << (delivered ? totalEndToEndUs / delivered : 0)
+         << " us, max " << maxEndToEndUs << " us\n";
+
+    if (!outFile.empty()) {
+        if (!writeCapture(outFile, heard, startEpochNs)) {
+            cerr << "[SIM] Cannot write capture file: " << outFile << endl;
+            return 1;
+        }
+        cout << "[SIM] Base arrivals written to " << outFile << endl;
+    }
+    return lost == 0 && repeated == 0 ? 0 : 1;
+}
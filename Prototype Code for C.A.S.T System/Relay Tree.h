@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+// Relay tree addressing and duplicate filtering, shared by the receiver's relay
+// mode and the Relay Tree Simulator.
+//
+// Nodes use RF24Network-style octal tree ids: 0 is the base receiver, 01-04 its
+// children, 011-044 theirs, and so on. Each digit (1-4) selects the reading pipe
+// (2-5) on the parent that a child writes to, so forwarding always moves one
+// level up the tree: no routing loops, and the path is at most MAX_HOPS long.
+
+#define MAX_HOPS 4              // max tree depth (octal digits in a node id)
+#define MAX_CHILDREN 4          // children per node, one per reading pipe 2-5
+#define DEDUP_WINDOW_MS 100     // same packet on another pipe within this window is a duplicate
+#define DEDUP_HISTORY 256       // covers DEDUP_WINDOW_MS at the full 2 Mbps packet rate (~2500 packets/s)
+#define DEDUP_PAYLOAD_SIZE 32   // largest RF24 payload
+
+// Recently received payloads, used to drop copies heard both directly and via a relay
+struct RecentPacket {
+    uint32_t hash;
+    uint8_t pipe;
+    uint8_t len;
+    uint8_t data[DEDUP_PAYLOAD_SIZE];
+    uint64_t timestampNs;
+    bool used;
+};
+struct DedupHistory {
+    RecentPacket packets[DEDUP_HISTORY] = {};
+    size_t index = 0;
+};
+
+// Check a payload against recent history. Repeats on the same pipe are legitimate (the
+// radio already drops its own retransmissions), but the same packet on another pipe means
+// it was heard both directly and via a relay. Only a byte-for-byte copy counts: STS packets
+// carry the transmitter's origin byte and a sequence number, so repeated Codec2 frames
+// (e.g. silence) never match each other and only a relayed copy of one packet is dropped.
+inline bool isDuplicate(DedupHistory& history, uint8_t pipe, uint64_t timestampNs, const uint8_t* payload, uint8_t len) {
+    if (len > DEDUP_PAYLOAD_SIZE) len = DEDUP_PAYLOAD_SIZE;
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (uint8_t i = 0; i < len; ++i) hash = (hash ^ payload[i]) * 16777619u;
+    hash = (hash ^ len) * 16777619u;
+
+    bool duplicate = false;
+    for (const RecentPacket& recent : history.packets) {
+        if (recent.used && recent.hash == hash && recent.pipe != pipe && recent.len == len &&
+            timestampNs - recent.timestampNs < DEDUP_WINDOW_MS * 1000000ULL &&
+            memcmp(recent.data, payload, len) == 0) {
+            duplicate = true;
+            break;
+        }
+    }
+    RecentPacket& slot = history.packets[history.index];
+    slot.hash = hash;
+    slot.pipe = pipe;
+    slot.len = len;
+    memcpy(slot.data, payload, len);
+    slot.timestampNs = timestampNs;
+    slot.used = true;
+    history.index = (history.index + 1) % DEDUP_HISTORY;
+    return duplicate;
+}
+
+// Number of octal digits in a node id
+inline int nodeDepth(uint16_t node) {
+    int depth = 0;
+    while (node) {
+        node >>= 3;
+        depth++;
+    }
+    return depth;
+}
+
+// Check every octal digit is a valid child slot and the tree is not too deep
+inline bool validNode(uint16_t node) {
+    if (node == 0 || nodeDepth(node) > MAX_HOPS) return false;
+    for (uint16_t n = node; n; n >>= 3) {
+        if ((n & 07) < 1 || (n & 07) > MAX_CHILDREN) return false;
+    }
+    return true;
+}
+
+// Parse an octal node id; the whole argument must be octal digits (so "018" is rejected, not read as 01)
+inline bool parseNode(const char* text, uint16_t& node) {
+    if (text[0] < '0' || text[0] > '7') return false; // strtoul would skip spaces and signs
+    char* end = nullptr;
+    unsigned long value = strtoul(text, &end, 8);
+    if (*end != '\0' || value > 0xFFFF) return false;
+    node = static_cast<uint16_t>(value);
+    return validNode(node);
+}
+
+// Parent id: drop the highest digit
+inline uint16_t parentNode(uint16_t node) {
+    return node & ((1 << (3 * (nodeDepth(node) - 1))) - 1);
+}
+
+// Pipe address of a node: upper 4 bytes identify the node, low byte the pipe.
+// Node 0 pipe 1 is the original 0x7878787878 so existing transmitters reach the base.
+inline uint64_t nodePipeAddress(uint16_t node, uint8_t pipe) {
+    return (static_cast<uint64_t>(0x78787878u ^ node) << 8) | (0x77 + pipe);
+}
+
+// Address this node forwards to: the parent's pipe for our child slot
+inline uint64_t uplinkAddress(uint16_t node) {
+    uint8_t slot = node >> (3 * (nodeDepth(node) - 1));
+    return nodePipeAddress(parentNode(node), slot + 1);
+}
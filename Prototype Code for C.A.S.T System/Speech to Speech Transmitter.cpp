@@ -7,6 +7,9 @@
 #include "codec2.h"
 #include <chrono>
 #include <filesystem>
+#include <random>
+#include "Outbound Queue.h"
+#include "Message Log Store.h"
 
 // Audio and transmission configuration
 #define SAMPLE_RATE 8000
@@ -14,11 +17,60 @@
 #define PACKET_SIZE 32
 #define PIN_CE 17
 #define PIN_CSN 0
+#define STS_HEADER 4       // length (0xFF = EOF), origin, uint16 sequence
+#define STS_FRAME_BYTES 4  // codec2_bytes_per_frame() for CODEC2_MODE_700C; 7 whole frames per packet
+#define STS_FRAME_MS 40    // audio per 700C frame
 
 RF24 radio(PIN_CE, PIN_CSN); // NRF24L01+ radio module
 
-// Record 5 seconds of audio, encode with Codec2, and transmit via RF24
-void transmit() {
+// Identifies this transmitter's packets so the receiver can tell a relayed copy of a
+// packet from a repeated Codec2 frame (e.g. silence) sent again
+const uint8_t origin = static_cast<uint8_t>(std::random_device{}());
+uint16_t sequence = 0;
+
+// Fill in the STS packet header
+void stampPacket(std::vector<unsigned char>& packet, unsigned char length) {
+    packet[0] = length;
+    packet[1] = origin;
+    packet[2] = sequence & 0xFF;
+    packet[3] = sequence >> 8;
+    sequence++;
+}
+
+// Send one queued recording: STS mode identifier, Codec2 frames packed into
+// length-prefixed, sequenced packets, then the EOF marker. Returns false if a packet is not acknowledged.
+bool sendAudio(const std::string& encoded) {
+    radio.stopListening();
+    std::cout << "Starting transmission...\n";
+
+    const std::string mode = "STS";
+    const char endMsg[] = "EOF";
+    if (!radio.write(mode.c_str(), mode.size()) || !radio.write(endMsg, sizeof(endMsg))) return false;
+
+    size_t sent = 0;
+    while (sent < encoded.size()) {
+        // Whole frames only, so a lost packet does not shift the frame boundaries after it
+        size_t chunkSize = std::min((size_t)(PACKET_SIZE - STS_HEADER) / STS_FRAME_BYTES * STS_FRAME_BYTES,
+                                    encoded.size() - sent);
+        std::vector<unsigned char> packet(PACKET_SIZE, 0);
+        stampPacket(packet, static_cast<unsigned char>(chunkSize));
+        std::copy(encoded.begin() + sent, encoded.begin() + sent + chunkSize, packet.begin() + STS_HEADER);
+
+        if (!radio.write(packet.data(), PACKET_SIZE)) return false;
+        sent += chunkSize;
+        std::cout << "Sent packet (" << static_cast<int>(chunkSize) << " bytes)\n";
+    }
+
+    // Transmit EOF Marker
+    std::vector<unsigned char> eofPacket(PACKET_SIZE, 0xEE);
+    stampPacket(eofPacket, 0xFF);
+    if (!radio.write(eofPacket.data(), PACKET_SIZE)) return false;
+    std::cout << "[TX] Sent EOF marker.\n";
+    return true;
+}
+
+// Record 5 seconds of audio, encode with Codec2, and queue it for transmission via RF24
+void transmit(OutboundQueue& outbox) {
     std::string outputFilename = "logs/STS/STS.raw";
 
     // asoundlib Audio Capture Setup
@@ -80,34 +132,18 @@ void transmit() {
     std::vector<short> speechSamples(nsam);
     std::vector<unsigned char> compressedBytes(codec2_bytes_per_frame(codec2));
 
-    // Codec 2 Encoding & RF24 Transmission 
-    radio.stopListening();
-    std::cout << "Starting transmission...\n";
-
+    // Codec 2 Encoding
+    std::string encoded;
     while (fread(speechSamples.data(), sizeof(short), nsam, fin) == nsam) {
         codec2_encode(codec2, compressedBytes.data(), speechSamples.data());
-
-        size_t sent = 0;
-        while (sent < compressedBytes.size()) {
-            size_t chunkSize = std::min((size_t)(PACKET_SIZE - 1), compressedBytes.size() - sent);
-            std::vector<unsigned char> packet(PACKET_SIZE, 0);
-            packet[0] = static_cast<unsigned char>(chunkSize);
-            std::copy(compressedBytes.begin() + sent, compressedBytes.begin() + sent + chunkSize, packet.begin() + 1);
-
-            radio.write(packet.data(), PACKET_SIZE);
-            sent += chunkSize;
-            std::cout << "Sent packet (" << static_cast<int>(chunkSize) << " bytes)\n";
-        }
+        encoded.append(compressedBytes.begin(), compressedBytes.end());
     }
 
     fclose(fin);
     codec2_destroy(codec2);
 
-    // Transmit EOF Marker
-    std::vector<unsigned char> eofPacket(PACKET_SIZE, 0xEE);
-    eofPacket[0] = 0xFF;
-    radio.write(eofPacket.data(), PACKET_SIZE);
-    std::cout << "[TX] Sent EOF marker.\n";
+    // Persist before sending so the recording survives an out of range receiver or a restart
+    outbox.enqueue("STS", encoded);
 }
 
 // RF24 Initilization & Main Transmit Function
@@ -128,8 +164,25 @@ int main() {
     radio.openWritingPipe(0x7878787878LL);
     radio.openReadingPipe(1, 0x7878787878LL);
 
-    // Start transmit process
-    transmit();
+    // Deliver recordings in the background, starting with any left from a previous run
+    OutboundQueue outbox("logs/outbox/STS", [](const std::vector<OutboundMessage>& batch) {
+        size_t delivered = 0;
+        while (delivered < batch.size() && sendAudio(batch[delivered].payload)) {
+            // Audio is not searchable, so the store records what was sent and how long it was
+            static MessageLogStore sentStore("logs/store_STS"); // only touched by the outbox thread
+            size_t frames = batch[delivered].payload.size() / STS_FRAME_BYTES;
+            sentStore.append(MESSAGE_DIRECTION_SENT, "STS", "local",
+                             "Recording, " + std::to_string(frames * STS_FRAME_MS) + " ms of Codec2 700C audio");
+            delivered++;
+        }
+        return delivered;
+    });
+    if (!outbox.isOpen()) return 1;
+    outbox.start();
+
+    // Start transmit process and wait for the link to take everything queued
+    transmit(outbox);
+    outbox.waitUntilDrained();
 
     return 0;
 }
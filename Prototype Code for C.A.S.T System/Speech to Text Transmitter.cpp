@@ -13,6 +13,8 @@
 
 #include <wiringPi.h>
 #include <RF24/RF24.h>
+#include "Outbound Queue.h"
+#include "Message Log Store.h"
 
 // Audio and filter configuration
 #define SAMPLE_RATE 16000
@@ -78,16 +80,17 @@ bool saveWavFile(const string& filename, const vector<float>& samples) {
     return true;
 }
 
-// Transmit a text message over RF24 in 32 byte chunks ending with EOF marker transmission
-void sendMessage(RF24& radio, const string& message) {
+// Transmit a text message over RF24 in 32 byte chunks ending with EOF marker transmission.
+// Returns false as soon as the receiver fails to acknowledge a packet.
+bool sendMessage(RF24& radio, const string& message) {
     size_t index = 0, chunkSize = 32;
     while (index < message.length()) {
         string chunk = message.substr(index, chunkSize);
-        radio.write(chunk.c_str(), chunk.size());
+        if (!radio.write(chunk.c_str(), chunk.size())) return false;
         index += chunkSize;
         delay(500);
     }
-    radio.write("EOF", 4);
+    return radio.write("EOF", 4);
 }
 
 int main() {
@@ -156,15 +159,34 @@ int main() {
     radio.setChannel(121);
     radio.setPALevel(RF24_PA_HIGH);
     radio.setDataRate(RF24_2MBPS);
-    radio.setAutoAck(false);
+    radio.setAutoAck(true); // acks tell the outbox whether the transcription was delivered
     radio.enableDynamicPayloads();
     radio.setRetries(15, 15);
     radio.openWritingPipe(0x7878787878LL);
-
-    // Transmit mode identifier followed by transcription
-    sendMessage(radio, "STT");
-    this_thread::sleep_for(chrono::milliseconds(500));
-    sendMessage(radio, transcription.str());
+    radio.openReadingPipe(1, 0x7878787878LL);
+
+    // Queue the transcription so it survives an out of range receiver or a restart; each
+    // transfer is the mode identifier STT followed by the text. Absolute path, as the
+    // working directory is now whisper.cpp's
+    OutboundQueue outbox("/home/will/FinalCodes/STT/logs/outbox/STT", [&radio](const vector<OutboundMessage>& batch) {
+        size_t delivered = 0;
+        while (delivered < batch.size()) {
+            const OutboundMessage& message = batch[delivered];
+            if (!sendMessage(radio, message.mode)) break;
+            this_thread::sleep_for(chrono::milliseconds(500));
+            if (!sendMessage(radio, message.payload)) break;
+            cout << "Transcription transmitted.\n";
+            static MessageLogStore sentStore("/home/will/FinalCodes/STT/logs/store_STT"); // only touched by the outbox thread
+            sentStore.append(MESSAGE_DIRECTION_SENT, message.mode, "local", message.payload);
+            delivered++;
+        }
+        return delivered;
+    });
+    if (!outbox.isOpen()) return 1;
+    outbox.start();
+
+    outbox.enqueue("STT", transcription.str());
+    outbox.waitUntilDrained();
 
     return 0;
 }
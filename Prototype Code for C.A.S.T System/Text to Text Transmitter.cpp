@@ -9,6 +9,10 @@
 #include <algorithm>
 #include <filesystem>
 #include <vector>
+#include <mutex>
+#include <chrono>
+#include "Outbound Queue.h"
+#include "Message Log Store.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -18,6 +22,15 @@ namespace fs = std::filesystem;
 #define PIN_CE 17
 #define PIN_CSN 0
 
+// Small pending messages are coalesced into one transfer up to this many bytes,
+// separated by an ASCII record separator the receiver splits on
+#define COALESCE_MAX_BYTES 160
+#define MESSAGE_SEPARATOR '\x1e'
+
+// Silence after a failed transfer before anything is resent; the receiver discards a
+// transfer once it has been quiet for 1 s
+#define RESEND_GAP_MS 1500
+
 // Generate timestamp for filenames and logs
 string getTimestamp() {
     time_t now = time(0);
@@ -29,6 +42,8 @@ string getTimestamp() {
 
 // Append  log entry to the CSV summary file
 void logToCSV(const string& type, const string& message, const string& filename) {
+    static mutex csvMutex; // shared with the outbox delivery thread
+    lock_guard<mutex> lock(csvMutex);
     fs::create_directories("logs");
     ofstream csv("logs/log_summary.csv", ios::app);
     string timestamp = getTimestamp();
@@ -41,6 +56,10 @@ string saveMessageToLogFile(const string& message, const string& mode) {
     fs::create_directories("logs");
     string timestamp = getTimestamp();
     string filename = "logs/" + mode + "_" + timestamp + ".txt";
+    for (int n = 2; fs::exists(filename); ++n) {
+        // Messages typed or presets picked within the same second would overwrite each other
+        filename = "logs/" + mode + "_" + timestamp + "_" + to_string(n) + ".txt";
+    }
     ofstream out(filename);
     out << message;
     out.close();
@@ -48,22 +67,56 @@ string saveMessageToLogFile(const string& message, const string& mode) {
     return filename;
 }
 
-// Send the contents of a file over RF24 in 32 byte chunks followed by EOF marker transmission
-void sendFile(RF24& radio, const string& filePath) {
-    ifstream file(filePath);
-    char buffer[32];
-    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
-        size_t bytesRead = file.gcount();
-        radio.write(buffer, bytesRead);
+// Send text over RF24 in 32 byte chunks followed by EOF marker transmission.
+// Returns false as soon as the receiver fails to acknowledge a packet.
+bool sendText(RF24& radio, const string& text) {
+    for (size_t index = 0; index < text.size(); index += 32) {
+        string chunk = text.substr(index, 32);
+        if (!radio.write(chunk.c_str(), chunk.size())) return false;
         delay(500);
     }
 
     // Send EOF marker
     string endMsg = "EOF";
-    radio.write(endMsg.c_str(), endMsg.size() + 1);
+    return radio.write(endMsg.c_str(), endMsg.size() + 1);
+}
+
+// Deliver a batch of queued messages. Consecutive small normal messages with the same mode
+// are joined into one transfer (one mode identifier, one EOF); urgent ones always go alone.
+// Stops between transfers when an emergency preset is queued so it jumps ahead.
+size_t sendBatch(RF24& radio, OutboundQueue& outbox, const vector<OutboundMessage>& batch) {
+    size_t delivered = 0;
+    while (delivered < batch.size() && !outbox.urgentWaiting()) {
+        const OutboundMessage& first = batch[delivered];
+        string text = first.payload;
+        size_t count = 1;
+        while (!first.urgent && delivered + count < batch.size()) {
+            const OutboundMessage& next = batch[delivered + count];
+            if (next.urgent || next.mode != first.mode ||
+                text.size() + 1 + next.payload.size() > COALESCE_MAX_BYTES) break;
+            text += MESSAGE_SEPARATOR;
+            text += next.payload;
+            count++;
+        }
 
-    // Notify user of successful transmission
-    cout << "Text file transmitted!\n";
+        if (!sendText(radio, first.mode) || !sendText(radio, text)) {
+            // The outbox backs off before retrying, except when an urgent message is waiting
+            if (outbox.urgentWaiting()) delay(RESEND_GAP_MS);
+            break;
+        }
+
+        // Notify user of successful transmission
+        chrono::duration<double, milli> latency = chrono::steady_clock::now() - first.queued;
+        cout << "\n[OUTBOX] " << count << " message(s) transmitted in one transfer, "
+             << latency.count() << " ms after queueing\n";
+        static MessageLogStore sentStore("logs/store_TTT"); // only touched by the outbox thread
+        for (size_t i = 0; i < count; ++i) {
+            logToCSV(first.mode + "-DELIVERED", batch[delivered + i].payload, "");
+            sentStore.append(MESSAGE_DIRECTION_SENT, first.mode, "local", batch[delivered + i].payload);
+        }
+        delivered += count;
+    }
+    return delivered;
 }
 
 int main() {
@@ -77,24 +130,30 @@ int main() {
     radio.setChannel(121);
     radio.setPALevel(RF24_PA_HIGH);
     radio.setDataRate(RF24_2MBPS);
-    radio.setAutoAck(false);
+    radio.setAutoAck(true); // acks tell the outbox whether a message was delivered
     radio.enableDynamicPayloads();
     radio.setRetries(15, 15);
     radio.openWritingPipe(0x7878787878LL);
     radio.openReadingPipe(1, 0x7878787878LL);
 
-    // Send initial mode identifier TTT 
-    string mode1 = "TTT";
-    string emptyMessage = "1";
-    string file = saveMessageToLogFile(emptyMessage, mode1);
-    radio.write("TTT", 3);
-    sendFile(radio, file);
+    // Input and transmission are decoupled: this thread only reads the console and queues
+    // messages, the outbox thread sends them (including any left from a previous run),
+    // each transfer prefixed with the mode identifier TTT
+    OutboundQueue outbox("logs/outbox/TTT", [&radio, &outbox](const vector<OutboundMessage>& batch) {
+        return sendBatch(radio, outbox, batch);
+    });
+    if (!outbox.isOpen()) return 1;
+    outbox.start();
 
     // Main loop for user use
     while (true) {
         string mode;
         cout << "\nChoose mode:\n1. Send Message\n2. Send Emergency Message\nChoice: ";
-        cin >> mode;
+        if (!(cin >> mode)) {
+            // End of input (e.g. scripted burst) - let the queue drain, then exit
+            outbox.waitUntilDrained();
+            break;
+        }
         cin.ignore();
 
         if (mode == "1") {
@@ -102,8 +161,11 @@ int main() {
             string msg;
             cout << "Enter your message (type 'EOF' to finish): ";
             getline(cin, msg);
-            string file = saveMessageToLogFile(msg, "TTT");
-            sendFile(radio, file);
+            auto typed = chrono::steady_clock::now();
+            saveMessageToLogFile(msg, "TTT");
+            outbox.enqueue("TTT", msg);
+            chrono::duration<double, milli> inputLatency = chrono::steady_clock::now() - typed;
+            cout << "Queued (" << inputLatency.count() << " ms, " << outbox.pending() << " pending)\n";
 
         } else if (mode == "2") {
             // Emergency preset selection
@@ -130,9 +192,9 @@ int main() {
                 continue;
             }
 
-            // Send selected emergency message
-            string file = saveMessageToLogFile(presets[choice - 1], "STT-EMERGENCY");
-            sendFile(radio, file);
+            // Send selected emergency message ahead of anything still queued
+            saveMessageToLogFile(presets[choice - 1], "STT-EMERGENCY");
+            outbox.enqueue("TTT", presets[choice - 1], true);
 
         } else {
             // Invalid input handler